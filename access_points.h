@@ -0,0 +1,1489 @@
+#ifndef ACCESS_POINTS_H
+#define ACCESS_POINTS_H
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <exception>
+#include <functional>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "contention_kernel.h"
+#include "instrumentation.h"
+#include "latency_histogram.h"
+#include "output_analysis.h"
+#include "quantile_sketch.h"
+#include "rng.h"
+#include "sim_engine.h"
+#include "station_table.h"
+#include "trace_writer.h"
+#include "traffic_replay.h"
+#include "wifi_user.h"
+
+// The access point models of the three generations and what they share:
+// channel state, PHY rates, result records and report helpers. Each access
+// point owns its scheduler and statistics and is reused from run to run.
+
+// Base exception class for WiFi errors
+class wifi_exception : public std::exception {
+protected:
+    std::string message;
+public:
+    explicit wifi_exception(const std::string& msg) : message(msg) {}
+    const char* what() const noexcept override { return message.c_str(); }
+};
+
+// Network packet class to handle data transmission (WiFi 4)
+class NetworkPacket {
+private:
+    int size;
+    double transmissionTime;
+    std::string type;
+
+public:
+    NetworkPacket(int sizeBytes, double bandwidth, double modulation, const std::string& packetType = "DATA")
+        : size(sizeBytes), type(packetType) {
+        if (sizeBytes <= 0 || bandwidth <= 0 || modulation <= 0) {
+            throw wifi_exception("Invalid packet parameters");
+        }
+        transmissionTime = (size * 8.0) / (bandwidth * modulation);
+    }
+
+    int getSize() const { return size; }
+    double getTransmissionTime() const { return transmissionTime; }
+    std::string getType() const { return type; }
+};
+
+// Frequency channel class to manage channel state
+class FreqChannel {
+public:
+    enum State { FREE, OCCUPIED };
+
+private:
+    State state;
+    std::string identifier;
+
+public:
+    FreqChannel(const std::string& id = "Default") : state(FREE), identifier(id) {}
+    
+    void setState(State newState) {
+        if (newState != state) countHotPath(HotCounter::ChannelFlips);
+        state = newState;
+    }
+    bool isAvailable() const { return state == FREE; }
+    std::string getIdentifier() const { return identifier; }
+};
+
+// Shared count of idle backoff slots on a channel. It only advances once the
+// medium has been idle for DIFS, so stopping it when the medium goes busy
+// freezes every station's countdown at once, and a station's backoff is
+// just the absolute slot at which it may transmit.
+class IdleSlotClock {
+private:
+    SimTime slotTime;
+    uint64_t slotsAtPause;
+    SimTime countingFrom;
+    bool running;
+
+public:
+    explicit IdleSlotClock(SimTime slotTime) : slotTime(slotTime) { reset(); }
+
+    void reset() {
+        slotsAtPause = 0;
+        countingFrom = 0;
+        running = false;
+    }
+
+    uint64_t slotsAt(SimTime t) const {
+        if (!running || t <= countingFrom) return slotsAtPause;
+        return slotsAtPause + static_cast<uint64_t>((t - countingFrom) / slotTime);
+    }
+
+    // When a running clock reaches `slot` (slot >= slotsAt(now))
+    SimTime timeOfSlot(uint64_t slot) const {
+        return countingFrom + static_cast<SimTime>(slot - slotsAtPause) * slotTime;
+    }
+
+    void pauseAt(uint64_t slot) {
+        slotsAtPause = slot;
+        running = false;
+    }
+
+    // Resumes counting at `t`, i.e. once the medium has been idle for DIFS
+    void resumeAt(SimTime t) {
+        countingFrom = t;
+        running = true;
+    }
+};
+
+// Report how fast the discrete-event engine ran
+inline void printEngineStats(std::ostream& out, const EventScheduler& scheduler) {
+    out << "Engine (" << queueBackendName(scheduler.getBackend()) << "): "
+              << scheduler.eventsProcessed() << " events in "
+              << scheduler.elapsedWallSeconds() * 1000 << " ms ("
+              << scheduler.eventsPerSecond() / 1e6 << " M events/s), "
+              << scheduler.stalePops() << " stale pops ("
+              << (scheduler.eventsProcessed() ? static_cast<double>(scheduler.stalePops()) / scheduler.eventsProcessed() : 0)
+              << " per event)\n";
+}
+
+// Tail latencies from a histogram, in ms
+inline void printLatencyPercentiles(std::ostream& out, const LatencyHistogram& latencies) {
+    out << "Latency Percentiles: p50 " << toMilliseconds(latencies.percentile(50))
+        << " ms, p90 " << toMilliseconds(latencies.percentile(90))
+        << " ms, p99 " << toMilliseconds(latencies.percentile(99))
+        << " ms, p99.9 " << toMilliseconds(latencies.percentile(99.9))
+        << " ms, p99.99 " << toMilliseconds(latencies.percentile(99.99)) << " ms\n";
+}
+
+// Batch-means confidence intervals for mean latency and throughput, and the
+// outcome of sequential stopping when it was requested
+inline void printConfidenceIntervals(std::ostream& out, const SequentialEstimator& estimator, double packetSizeInBits) {
+    const BatchMeans& latency = estimator.latencySeries();
+    const BatchMeans& interval = estimator.intervalSeries();
+    const double confidence = estimator.getRule().confidence;
+    if (latency.batchCount() >= 2) {
+        double relative = interval.relativeHalfWidth(confidence);
+        double throughput = packetSizeInBits / interval.mean() * 1e3;   // bits per ns -> Mbps
+        out << confidence * 100 << "% CI Latency: " << latency.mean() / 1e6 << " +- "
+            << latency.halfWidth(confidence) / 1e6 << " ms (" << latency.relativeHalfWidth(confidence) * 100 << "%), "
+            << "Throughput: " << throughput << " +- " << throughput * relative << " Mbps (" << relative * 100 << "%)\n";
+    }
+    if (estimator.active()) {
+        out << "Sequential Stopping: " << (estimator.converged() ? "target reached" : "target not reached")
+            << " (+-" << estimator.getRule().relativeHalfWidth * 100 << "%) after " << latency.count() << " packets\n";
+    }
+}
+
+// Modulation and coding schemes by 802.11ac/ax index. A 20 MHz channel
+// carries 20 M symbols/s, so the PHY rate is 20e6 * bitsPerSymbol *
+// codingRate. MCS 9 (256-QAM, 5/6) is every generation's default; 10 and 11
+// (1024-QAM) are WiFi 6 only.
+struct ModulationCoding {
+    int bitsPerSymbol;
+    double codingRate;
+};
+
+inline constexpr ModulationCoding mcsTable[] = {
+    {1, 1.0 / 2}, {2, 1.0 / 2}, {2, 3.0 / 4}, {4, 1.0 / 2}, {4, 3.0 / 4}, {6, 2.0 / 3},
+    {6, 3.0 / 4}, {6, 5.0 / 6}, {8, 3.0 / 4}, {8, 5.0 / 6}, {10, 3.0 / 4}, {10, 5.0 / 6},
+};
+constexpr int defaultMcs = 9;
+
+inline int maxMcs(int generation) { return generation == 6 ? 11 : 9; }
+
+inline double phyRate(int mcs) { return 20e6 * mcsTable[mcs].bitsPerSymbol * mcsTable[mcs].codingRate; }
+
+// One scenario's (or replication's) outcome, for machine-readable output.
+// The caller fills in the scenario; the access point the measurements.
+struct SimulationResult {
+    int generation = 0;
+    int clients = 0;
+    int packets = 0;
+    int mcs = defaultMcs;
+    int replication = 0;
+    uint64_t seed = 0;
+    uint64_t delivered = 0;
+    uint64_t dropped = 0;
+    uint64_t warmupDiscarded = 0;
+    double simulatedSeconds = 0;
+    double throughputMbps = 0;
+    double meanLatencyMs = 0;
+    double p50LatencyMs = 0;
+    double p90LatencyMs = 0;
+    double p99LatencyMs = 0;
+    double p999LatencyMs = 0;
+    double maxLatencyMs = 0;
+    double wallSeconds = 0;   // host time spent on the scenario
+};
+
+inline void fillLatencyResult(SimulationResult& result, const LatencyHistogram& latencies) {
+    result.meanLatencyMs = toMilliseconds(latencies.mean());
+    result.p50LatencyMs = toMilliseconds(latencies.percentile(50));
+    result.p90LatencyMs = toMilliseconds(latencies.percentile(90));
+    result.p99LatencyMs = toMilliseconds(latencies.percentile(99));
+    result.p999LatencyMs = toMilliseconds(latencies.percentile(99.9));
+    result.maxLatencyMs = toMilliseconds(latencies.max());
+}
+
+// One line summarizing a (possibly merged) latency sketch
+inline void printSketchSummary(std::ostream& out, const std::string& label, const QuantileSketch& sketch) {
+    out << label << ": " << sketch.count() << " packets, mean " << sketch.mean() / 1e6
+        << " ms, p50 " << toMilliseconds(sketch.quantile(0.5))
+        << " ms, p99 " << toMilliseconds(sketch.quantile(0.99))
+        << " ms, p99.9 " << toMilliseconds(sketch.quantile(0.999))
+        << " ms, max " << toMilliseconds(sketch.max()) << " ms\n";
+}
+
+// Base network user class for WiFi 4
+class NetworkUser {
+protected:
+    int userID;
+    double backoffTime;
+    bool active;
+
+public:
+    NetworkUser(int id) : userID(id), backoffTime(0), active(true) {}
+    virtual ~NetworkUser() = default;
+
+    bool checkActivityStatus() const { return active; }
+    void setActivityStatus(bool status) { active = status; }
+    int getUserID() const { return userID; }
+};
+
+// MAC event types shared by the access point models
+enum MacEvent : uint8_t {
+    ARRIVAL,         // a packet enters a station's queue
+    BACKOFF_EXPIRY,  // a station's backoff countdown reaches zero
+    TX_START,        // the AP opens a downlink transmit opportunity
+    TX_END,          // the data frame leaves the air
+    ACK,             // (block) ACK received, or ACK timeout after a collision
+    REPLAY_ARRIVAL   // the next packet of a replayed trace arrives
+};
+
+// WiFi 6 User implementation with OFDMA support
+class WiFi6User : public NetworkUser {
+private:
+    int allocatedSubChannel;
+public:
+    WiFi6User(int id) : NetworkUser(id), allocatedSubChannel(-1) {}
+
+    void allocateSubChannel(int subChannel) {
+        allocatedSubChannel = subChannel;
+    }
+
+    int getAllocatedSubChannel() const {
+        return allocatedSubChannel;
+    }
+
+    // The AP reserves the channel for the whole OFDMA transmission once every
+    // resource unit has been granted, so this only checks the grant.
+    bool attemptTransmission(const FreqChannel& channel, int subChannel) const {
+        return allocatedSubChannel == subChannel && channel.isAvailable();
+    }
+};
+
+// WiFi 4 Access Point class to manage network activity.
+// Stations run DCF on a shared channel: each one counts down its backoff
+// while the medium is idle and freezes it while the medium is busy, stations
+// that finish in the same slot collide, and the medium stays busy for
+// DATA + SIFS + ACK. A packet is dropped after 7 retries. Backoffs are
+// absolute targets on a shared idle-slot clock, so a busy period costs
+// O(transmitters log N), not O(N). Traffic is saturated: a station's next
+// packet is queued as soon as the previous one is acknowledged, unless an
+// arrivals trace is replayed (event engine only).
+// simulateSlotted() runs the same model by counting every backoff down one
+// idle slot at a time with the vectorized countdown kernel.
+class WiFi4AccessPoint {
+private:
+    // Heap order of the contenders: earliest backoff target first, ties
+    // broken by station id
+    struct ExpiresLater {
+        const StationTable* stations;
+        bool operator()(uint32_t a, uint32_t b) const { return stations->expiresAfter(a, b); }
+    };
+
+    FreqChannel channel;
+    StationTable stations;
+    std::vector<uint32_t> contenders;     // min-heap of station ids by backoff target
+    LatencyHistogram latencyRecords;
+    QuantileSketch latencySketch;         // mergeable copy for cross-run reports
+    SequentialEstimator estimator;
+    WarmupTruncation warmup;              // holds early latencies until the warm-up is known
+    PacketTracer* tracer;                 // per-packet trace, nullptr when off
+    std::vector<SimTime> firstAttempts;   // start of each head-of-line packet's first attempt (tracing only)
+    TrafficReplay replay;                 // recorded arrivals, inactive when saturated
+    int successfulTransfers;
+    int droppedPackets;
+    uint64_t transmissionAttempts;        // every frame put on the air, collided or not
+    double totalDuration;
+    double deliveredBits;                 // replayed frames vary in size
+    double transferRate;
+    const double packetSizeInBits;
+    const int retryLimit;
+    const SimTime slotTime;
+    const SimTime sifs;
+    const SimTime difs;
+    const SimTime ackDuration;
+    SimTime txDuration;
+    SimTime busyDuration;                 // data frame airtime of the current busy period
+
+    EventScheduler scheduler;
+    IdleSlotClock idleSlots;
+    EventHandle nextAccess;   // expiry of the earliest backoff target
+    std::vector<int32_t> transmitters;   // stations on the air this busy period
+    std::vector<int32_t> retrying;
+    std::vector<int32_t> refilled;       // stations with their next packet queued
+    std::vector<uint32_t> expired;       // countdowns that ended this slot (slotted runs)
+    RngBatch backoffDraws;
+
+    bool slotted;                        // last run was slot-stepped
+    uint64_t slotsRun;
+    double slotWallSeconds;
+    SimTime slotClock;                   // start of the current idle slot
+    size_t activeStations;               // stations with packets left
+
+    void pushContender(int32_t station) {
+        contenders.push_back(static_cast<uint32_t>(station));
+        std::push_heap(contenders.begin(), contenders.end(), ExpiresLater{&stations});
+    }
+
+    int32_t popContender() {
+        std::pop_heap(contenders.begin(), contenders.end(), ExpiresLater{&stations});
+        int32_t station = static_cast<int32_t>(contenders.back());
+        contenders.pop_back();
+        return station;
+    }
+
+    // Schedules the one pending access event, for the earliest target. It is
+    // the scheduler's only cancellable event, so it goes to target 0 whatever
+    // station it is for.
+    void scheduleNextAccess() {
+        scheduler.cancel(nextAccess);
+        if (contenders.empty() || !channel.isAvailable()) return;
+        uint64_t target = stations.getBackoffTarget(contenders.front());
+        nextAccess = scheduler.scheduleCancellableAt(idleSlots.timeOfSlot(target), BACKOFF_EXPIRY, 0);
+    }
+
+    void joinContention(int32_t station) {
+        stations.setBackoffTarget(station, idleSlots.slotsAt(scheduler.now()) + stations.getBackoffInterval(station));
+        pushContender(station);
+        if (contenders.front() == static_cast<uint32_t>(station)) {
+            scheduleNextAccess();
+        }
+    }
+
+    // The earliest backoff expired: every station sharing that target slot
+    // transmits now (more than one is a collision). The idle-slot clock stops,
+    // which freezes all other countdowns at once.
+    void startTransmissions() {
+        PhaseTimer timer(SimPhase::Contention);
+        uint64_t slot = stations.getBackoffTarget(contenders.front());
+        idleSlots.pauseAt(slot);
+        channel.setState(FreqChannel::OCCUPIED);
+        transmitters.clear();
+        while (!contenders.empty() && stations.getBackoffTarget(contenders.front()) == slot) {
+            transmitters.push_back(popContender());
+        }
+        if (replay.active()) {
+            // The medium is busy until the longest of the frames has been sent
+            uint16_t longest = 0;
+            for (int32_t station : transmitters) longest = std::max(longest, replay.head(station).size);
+            busyDuration = frameDuration(longest);
+        }
+        scheduler.schedule(busyDuration, TX_END, -1);
+    }
+
+    // Redraws the backoff of every listed station in one batched RNG pass
+    void redrawBackoffs(const std::vector<int32_t>& redraw) {
+        backoffDraws.clear();
+        for (int32_t station : redraw) {
+            stations.reserveBackoffDraw(station, backoffDraws);
+        }
+        backoffDraws.generate();
+        for (size_t i = 0; i < redraw.size(); ++i) {
+            stations.applyBackoffDraw(redraw[i], backoffDraws[i]);
+        }
+    }
+
+    // Draws every station's first backoff, a few thousand at a time so the
+    // RNG batch stays small however many stations there are
+    void drawFirstBackoffs() {
+        const size_t chunk = 4096;
+        for (size_t first = 0; first < stations.size(); first += chunk) {
+            const size_t last = std::min(first + chunk, stations.size());
+            backoffDraws.clear();
+            for (size_t station = first; station < last; ++station) {
+                stations.reserveBackoffDraw(station, backoffDraws);
+            }
+            backoffDraws.generate();
+            for (size_t station = first; station < last; ++station) {
+                stations.applyBackoffDraw(station, backoffDraws[station - first]);
+            }
+        }
+    }
+
+    // Outcome of the busy period ending at `now`: ACK for a lone transmitter,
+    // ACK timeout and a doubled contention window for colliders. Colliders
+    // under the retry limit end up in `retrying`, stations that finished a
+    // packet and have another one queued in `refilled`.
+    void settleTransmitters(SimTime now) {
+        retrying.clear();
+        refilled.clear();
+        transmissionAttempts += transmitters.size();
+        bool collision = transmitters.size() > 1;
+        countHotPath(HotCounter::Attempts, transmitters.size());
+        if (collision) countHotPath(HotCounter::Collisions, transmitters.size());
+        for (int32_t station : transmitters) {
+            if (tracer && stations.getCollisionCount(station) == 0) {
+                firstAttempts[station] = now - busyDuration - sifs - ackDuration;
+            }
+            if (collision && stations.getCollisionCount(station) < retryLimit) {
+                stations.widenContentionWindow(station);
+                retrying.push_back(station);
+                continue;
+            }
+            if (tracer) tracePacket(station, now, collision ? PACKET_DROPPED : PACKET_DELIVERED);
+            if (collision) {
+                droppedPackets++;   // retry limit exhausted
+            } else {
+                SimTime latency = now - stations.getQueuedSince(station);
+                // Held-back latencies reach the estimator in truncateWarmup()
+                // if they survive the cut, so its interval covers the same
+                // packets as the reported average
+                if (warmup.hold(static_cast<double>(latency), static_cast<double>(now))) {
+                    estimator.skip(static_cast<double>(now));
+                } else {
+                    recordLatency(latency);
+                    estimator.observe(static_cast<double>(latency), static_cast<double>(now));
+                }
+                successfulTransfers++;
+                countHotPath(HotCounter::Successes);
+                if (replay.active()) deliveredBits += replay.head(station).size * 8.0;
+            }
+            stations.registerSuccess(station);
+            if (replay.active()) replay.retire(station);
+            if (stations.completePacket(station) > 0) {
+                refilled.push_back(station);
+            }
+        }
+    }
+
+    void tracePacket(int32_t station, SimTime now, PacketOutcome outcome) {
+        uint16_t size = replay.active() ? replay.head(station).size : static_cast<uint16_t>(packetSizeInBits / 8);
+        tracer->record(PacketRecord{stations.getQueuedSince(station), firstAttempts[station], now,
+                                    static_cast<uint32_t>(station), size,
+                                    static_cast<uint8_t>(stations.getCollisionCount(station)), outcome});
+    }
+
+    void recordLatency(SimTime latency) {
+        latencyRecords.record(latency);
+        latencySketch.add(latency);
+    }
+
+    SimTime frameDuration(uint16_t bytes) const { return static_cast<SimTime>(bytes * 8.0 / transferRate * 1e9); }
+
+    // Queues the trace's next packet and schedules the one after it. A
+    // station whose queue was empty starts contending for the packet.
+    void admitArrival(SimTime now) {
+        PhaseTimer timer(SimPhase::Arrivals);
+        int32_t station = replay.admit();
+        if (station >= 0 && stations.addPacket(station) == 1) {
+            stations.setQueuedSince(station, now);
+            stations.resetBackoffInterval(station);
+            joinContention(station);
+        }
+        if (replay.pending()) scheduler.scheduleAt(replay.nextArrival(), REPLAY_ARRIVAL, -1);
+    }
+
+    // End of a run: drops the detected warm-up and records the held-back
+    // latencies that follow it, also in front of the estimator's series
+    void truncateWarmup() {
+        const size_t cut = warmup.truncate();
+        for (size_t i = cut; i < warmup.heldCount(); ++i) {
+            recordLatency(static_cast<SimTime>(warmup.heldValue(i)));
+        }
+        estimator.prepend(warmup.heldCount() - cut,
+                          [this, cut](size_t i) { return warmup.heldValue(cut + i); },
+                          [this, cut](size_t i) {
+                              return warmup.heldTime(cut + i) - (cut + i > 0 ? warmup.heldTime(cut + i - 1) : 0);
+                          });
+    }
+
+    void finishTransmissions() {
+        PhaseTimer timer(SimPhase::Settle);
+        SimTime now = scheduler.now();
+        settleTransmitters(now);
+        if (estimator.converged()) {
+            scheduler.stop();
+            return;
+        }
+        for (int32_t station : refilled) {
+            scheduler.schedule(0, ARRIVAL, station);
+        }
+        redrawBackoffs(retrying);
+        for (int32_t station : retrying) {
+            joinContention(station);
+        }
+
+        channel.setState(FreqChannel::FREE);
+        idleSlots.resumeAt(now + difs);
+        scheduleNextAccess();
+    }
+
+public:
+    WiFi4AccessPoint() : 
+        tracer(nullptr),
+        successfulTransfers(0), 
+        droppedPackets(0),
+        transmissionAttempts(0),
+        totalDuration(0),
+        deliveredBits(0),
+        transferRate(phyRate(defaultMcs)),
+        packetSizeInBits(1024 * 8),
+        retryLimit(7),
+        slotTime(microseconds(9)),
+        sifs(microseconds(16)),
+        difs(microseconds(34)),
+        ackDuration(microseconds(32)),
+        txDuration(static_cast<SimTime>(packetSizeInBits / transferRate * 1e9)),
+        busyDuration(txDuration),
+        idleSlots(slotTime),
+        slotted(false),
+        slotsRun(0),
+        slotWallSeconds(0),
+        slotClock(0),
+        activeStations(0) {}
+
+    // The station keeps its id's RNG stream, continued where the user left it
+    void addClient(const WiFiUser& client) {
+        stations.add(client.getCollisionCount(), static_cast<uint16_t>(client.getBackoffInterval()),
+                     static_cast<uint32_t>(client.getDrawsUsed()), client.isWaitingForAccess());
+    }
+
+    void reserveClients(size_t n) { stations.reserve(n); }
+
+    // PHY rate of the data frames, by index into mcsTable
+    void setMcs(int mcs) {
+        transferRate = phyRate(mcs);
+        txDuration = static_cast<SimTime>(packetSizeInBits / transferRate * 1e9);
+        busyDuration = txDuration;
+    }
+
+    void setQueueBackend(QueueBackend backend) { scheduler.setBackend(backend); }
+
+    // Histogram resolution: latencies are kept to within 2^-(bits-1)
+    void setLatencyPrecision(int bits) { latencyRecords.setPrecision(bits); }
+
+    // Stop a run early once its confidence intervals reach the target
+    void setStoppingRule(const StoppingRule& rule) { estimator.setRule(rule); }
+
+    // MSER-5 truncation of the initial transient (on by default)
+    void setWarmupTruncation(bool enabled) { warmup.setCapacity(enabled ? 8192 : 0); }
+
+    // Records every packet's outcome to `trace` (nullptr turns tracing off)
+    void setTracer(PacketTracer* trace) { tracer = trace; }
+
+    // Replays `trace` instead of saturated traffic (nullptr: saturated); it
+    // must name no more stations than there are clients. simulateNetwork()
+    // only, the slot-stepped engine is always saturated.
+    void setArrivals(const ArrivalTrace* trace) { replay.setTrace(trace); }
+
+    const QuantileSketch& getLatencySketch() const { return latencySketch; }
+    uint64_t getTransmissionAttempts() const { return transmissionAttempts; }
+    const EventScheduler& getScheduler() const { return scheduler; }
+
+    // Memory that grows with the number of stations: the station table, the
+    // contender heap (event-driven runs), the expired list (slotted runs),
+    // the RNG batch and the per-busy-period station lists. Tracing adds 8
+    // bytes per station for the first-attempt times.
+    size_t stationMemoryBytes() const {
+        return stations.memoryBytes() + contenders.capacity() * sizeof(uint32_t) +
+               expired.capacity() * sizeof(uint32_t) + backoffDraws.memoryBytes() +
+               (transmitters.capacity() + retrying.capacity() + refilled.capacity()) * sizeof(int32_t);
+    }
+
+    // Must match the key the clients' streams were created with
+    void setRandomKey(const RngKey& key) {
+        stations.setRandomKey(key);
+        backoffDraws.setKey(key);
+    }
+
+    void simulateNetwork(int numPackets) {
+        slotted = false;
+        latencyRecords.clear();
+        latencySketch.clear();
+        estimator.clear();
+        warmup.clear();
+        successfulTransfers = 0;
+        droppedPackets = 0;
+        transmissionAttempts = 0;
+        totalDuration = 0;
+        deliveredBits = 0;
+        busyDuration = txDuration;
+
+        scheduler.reset();
+        channel.setState(FreqChannel::FREE);
+        stations.resetQueues(replay.active() ? 0 : static_cast<uint32_t>(std::max(numPackets, 0)));
+        if (tracer) firstAttempts.assign(stations.size(), 0);
+        contenders.clear();
+        contenders.reserve(stations.size());
+        scheduler.setCancellableTargets(1);
+        nextAccess = EventHandle();
+        idleSlots.reset();
+        idleSlots.resumeAt(difs);
+
+        if (replay.active()) {
+            // Queues fill as the trace's packets arrive; numPackets is ignored
+            replay.start();
+            if (replay.pending()) scheduler.scheduleAt(replay.nextArrival(), REPLAY_ARRIVAL, -1);
+            scheduler.run(*this);
+            totalDuration = toSeconds(scheduler.now());
+            droppedPackets += static_cast<int>(replay.getTailDrops());
+            truncateWarmup();
+            return;
+        }
+        if (numPackets <= 0) return;
+
+        // Every station has its first packet queued at t = 0
+        drawFirstBackoffs();
+        for (size_t station = 0; station < stations.size(); ++station) {
+            joinContention(static_cast<int32_t>(station));
+        }
+        scheduler.run(*this);
+        totalDuration = toSeconds(scheduler.now());
+        truncateWarmup();
+    }
+
+    // Slot-stepped run of the same model: each idle slot decrements every
+    // station's counter in the table at once, and a busy period is resolved
+    // as soon as some counters reach zero. Draws come from the same streams
+    // in the same per-station order, so the results equal simulateNetwork().
+    void simulateSlotted(int numPackets) {
+        auto start = std::chrono::steady_clock::now();
+        startSlotted(numPackets);
+        expired.resize(stations.size());
+        while (hasTraffic()) {
+            size_t count;
+            {
+                PhaseTimer timer(SimPhase::Contention);
+                count = countdownSlot(stations.backoffData(), stations.size(), expired.data());
+            }
+            advanceIdleSlots(1);
+            if (count > 0) {
+                busyPeriod(expired.data(), count);
+            }
+        }
+        slotWallSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    }
+
+    // Building blocks of a slot-stepped run, for callers that count the
+    // backoffs down themselves. startSlotted() queues every station's first
+    // packet and draws its backoff; the caller then alternates idle slots
+    // with busy periods until hasTraffic() turns false.
+    void startSlotted(int numPackets) {
+        slotted = true;
+        slotsRun = 0;
+        slotWallSeconds = 0;
+        latencyRecords.clear();
+        latencySketch.clear();
+        estimator.clear();
+        warmup.clear();
+        successfulTransfers = 0;
+        droppedPackets = 0;
+        transmissionAttempts = 0;
+        totalDuration = 0;
+        deliveredBits = 0;
+        busyDuration = txDuration;
+        scheduler.reset();
+        stations.resetQueues(static_cast<uint32_t>(std::max(numPackets, 0)));
+        if (tracer) firstAttempts.assign(stations.size(), 0);
+        slotClock = difs;   // idle since t = 0
+        activeStations = numPackets > 0 ? stations.size() : 0;
+        if (activeStations == 0) return;
+        drawFirstBackoffs();
+    }
+
+    bool hasTraffic() const { return activeStations > 0; }
+
+    void advanceIdleSlots(uint64_t slots) {
+        slotClock += static_cast<SimTime>(slots) * slotTime;
+        slotsRun += slots;
+    }
+
+    // The listed stations (ascending) transmit at the current slot. Settles
+    // the exchange and redraws the backoff of every station that contends
+    // again; those are listed by redrawnStations() until the next call.
+    void busyPeriod(const uint32_t* expired, size_t count) {
+        backoffDraws.clear();
+        settleBusyPeriod(expired, count, backoffDraws);
+        backoffDraws.generate();
+        applyRedraws(backoffDraws, 0);
+    }
+
+    // busyPeriod() in two halves, so the lockstep lanes can share one
+    // LaneRngBatch: the redraws are reserved in `draws` (under this AP's
+    // key) and applied once the batch is generated. Returns the index of
+    // the first reserved draw.
+    template <class Batch>
+    size_t settleBusyPeriod(const uint32_t* expired, size_t count, Batch& draws) {
+        PhaseTimer timer(SimPhase::Settle);
+        SimTime now = slotClock + txDuration + sifs + ackDuration;
+        transmitters.assign(expired, expired + count);
+        settleTransmitters(now);
+        for (int32_t station : refilled) {
+            stations.setQueuedSince(station, now);
+        }
+        activeStations -= transmitters.size() - retrying.size() - refilled.size();
+        if (estimator.converged()) activeStations = 0;
+        retrying.insert(retrying.end(), refilled.begin(), refilled.end());
+        totalDuration = toSeconds(now);
+        slotClock = now + difs;
+        if (activeStations == 0) truncateWarmup();
+
+        size_t first = draws.size();
+        for (int32_t station : retrying) {
+            stations.reserveBackoffDraw(station, draws);
+        }
+        return first;
+    }
+
+    template <class Batch>
+    void applyRedraws(const Batch& draws, size_t first) {
+        for (size_t i = 0; i < retrying.size(); ++i) {
+            stations.applyBackoffDraw(retrying[i], draws[first + i]);
+        }
+    }
+
+    const std::vector<int32_t>& redrawnStations() const { return retrying; }
+
+    size_t clientCount() const { return stations.size(); }
+    uint16_t getBackoffInterval(size_t station) const { return stations.getBackoffInterval(station); }
+    bool hasPacket(size_t station) const { return stations.getPacketsLeft(station) > 0; }
+
+    // Drops every client, so the AP can be reused for another scenario
+    void clearClients() { stations.clear(); }
+
+    // Event dispatch, called by the scheduler
+    void handleEvent(const Event& ev) {
+        const int station = ev.target;
+        const SimTime now = scheduler.now();
+        switch (ev.type) {
+        case ARRIVAL:
+            // A replayed packet has been waiting since it arrived
+            stations.setQueuedSince(station, replay.active() ? replay.head(station).arrival : now);
+            stations.resetBackoffInterval(station);
+            joinContention(station);
+            break;
+        case BACKOFF_EXPIRY:
+            startTransmissions();
+            break;
+        case TX_END:
+            scheduler.schedule(sifs + ackDuration, ACK, -1);
+            break;
+        case ACK:
+            finishTransmissions();
+            break;
+        case REPLAY_ARRIVAL:
+            admitArrival(now);
+            break;
+        }
+    }
+
+    // Throughput over the steady state only, capped at the channel rate.
+    // Replayed frames differ in size, so their bits are counted as they are
+    // delivered, over the whole run.
+    double achievableThroughputMbps() const {
+        double measuredDuration = totalDuration - toSeconds(static_cast<SimTime>(warmup.warmupEnd()));
+        double measuredTransfers = static_cast<double>(successfulTransfers - warmup.discarded());
+        double actualThroughput = measuredDuration > 0 ? (measuredTransfers * packetSizeInBits) / measuredDuration : 0;
+        if (replay.active()) actualThroughput = totalDuration > 0 ? deliveredBits / totalDuration : 0;
+        return std::min(actualThroughput / 1e6, transferRate / 1e6);
+    }
+
+    void fillResult(SimulationResult& result) const {
+        result.delivered = static_cast<uint64_t>(successfulTransfers);
+        result.dropped = static_cast<uint64_t>(droppedPackets);
+        result.warmupDiscarded = warmup.discarded();
+        result.simulatedSeconds = totalDuration;
+        result.throughputMbps = achievableThroughputMbps();
+        fillLatencyResult(result, latencyRecords);
+    }
+
+    void displayResults(std::ostream& out) const {
+        out << "--------------------------------------------------------\n";
+        out << "Simulation Results for " << stations.size() << " Clients:\n";
+
+        double maxPossibleThroughput = transferRate / 1e6;
+        double achievableThroughput = achievableThroughputMbps();
+
+        double avgLatency = toMilliseconds(latencyRecords.mean());
+        double peakLatency = toMilliseconds(latencyRecords.max());
+
+        out << "Throughput: " << maxPossibleThroughput << " Mbps\n"
+            << "Achievable Throughput: " << achievableThroughput << " Mbps\n"
+            << "Average Latency: " << avgLatency << " ms\n"
+            << "Peak Latency: " << peakLatency << " ms\n";
+        printLatencyPercentiles(out, latencyRecords);
+        printConfidenceIntervals(out, estimator, packetSizeInBits);
+        out << "Warm-up (MSER-5): discarded " << warmup.discarded() << " of " << successfulTransfers
+            << " packets, first " << toMilliseconds(static_cast<SimTime>(warmup.warmupEnd())) << " ms\n";
+        out << "Dropped Packets: " << droppedPackets << "\n";
+    }
+
+    void displayStatistics(std::ostream& out) const {
+        displayResults(out);
+        if (slotted) {
+            out << "Engine (slotted, " << simdLevelName(activeSimdLevel()) << "): "
+                      << slotsRun << " slots in " << slotWallSeconds * 1000 << " ms ("
+                      << (slotWallSeconds > 0 ? slotsRun / slotWallSeconds / 1e6 : 0) << " M slots/s)\n";
+        } else {
+            printEngineStats(out, scheduler);
+        }
+    }
+};
+
+// Runs independent replications of one WiFi 4 cell in lockstep, one per
+// vector lane. Each lane owns an access point that keeps the lane's station
+// state and settles its busy periods; only the backoff countdown is shared,
+// skipping every lane straight to its next expiry with one vector pass per
+// station. A lane whose replication finishes is refilled with the next one,
+// and lanes left without work are masked out by their zero counters.
+class WiFi4LockstepRunner {
+private:
+    WiFi4AccessPoint lanes[lockstepLanes];
+    int laneReplication[lockstepLanes];   // -1 for an idle lane
+    std::vector<uint16_t> counters;       // per station, one lane per replication
+    std::vector<uint32_t> expired;
+    LaneRngBatch redraws;                  // every lane's redraws for one step
+    size_t firstRedraw[lockstepLanes];
+    uint64_t steps;
+    double wallSeconds;
+    std::vector<std::string> reports;       // per replication, in key order
+    std::vector<QuantileSketch> sketches;
+    std::vector<SimulationResult> results;
+    std::unique_ptr<PacketTracer> tracers[lockstepLanes];   // one per lane when tracing
+    TraceBlockHeader traceBase;             // run header of keys[0]
+
+    void loadLane(int lane, int replication, const std::vector<RngKey>& keys, int numClients, int numPackets) {
+        WiFi4AccessPoint& ap = lanes[lane];
+        laneReplication[lane] = replication;
+        if (tracers[lane]) {
+            TraceBlockHeader run = traceBase;
+            run.replication += static_cast<uint32_t>(replication);
+            tracers[lane]->beginRun(run);
+        }
+        ap.clearClients();
+        ap.setRandomKey(keys[replication]);
+        ap.reserveClients(numClients);
+        for (int i = 0; i < numClients; ++i) {
+            ap.addClient(WiFiUser(i, keys[replication]));
+        }
+        ap.startSlotted(numPackets);
+        for (int i = 0; i < numClients; ++i) {
+            counters[i * lockstepLanes + lane] = ap.hasTraffic() ? ap.getBackoffInterval(i) : 0;
+        }
+    }
+
+public:
+    WiFi4LockstepRunner() : steps(0), wallSeconds(0), traceBase() {}
+
+    void setLatencyPrecision(int bits) {
+        for (WiFi4AccessPoint& ap : lanes) ap.setLatencyPrecision(bits);
+    }
+
+    void setStoppingRule(const StoppingRule& rule) {
+        for (WiFi4AccessPoint& ap : lanes) ap.setStoppingRule(rule);
+    }
+
+    void setWarmupTruncation(bool enabled) {
+        for (WiFi4AccessPoint& ap : lanes) ap.setWarmupTruncation(enabled);
+    }
+
+    void setMcs(int mcs) {
+        for (WiFi4AccessPoint& ap : lanes) ap.setMcs(mcs);
+    }
+
+    // Gives every lane its own trace buffers, smaller than a workspace's
+    void setTraceWriter(TraceWriter* writer) {
+        for (int lane = 0; lane < lockstepLanes; ++lane) {
+            tracers[lane].reset(writer ? new PacketTracer(*writer, size_t(1) << 17) : nullptr);
+            lanes[lane].setTracer(tracers[lane].get());
+        }
+    }
+
+    // Trace header of the first key's run; later keys count replications up from it
+    void setTraceRun(const TraceBlockHeader& run) { traceBase = run; }
+
+    // Runs one replication per key; each one's statistics block, latency
+    // sketch and result are then available in key order
+    void run(const std::vector<RngKey>& keys, int numClients, int numPackets) {
+        auto start = std::chrono::steady_clock::now();
+        const int replications = static_cast<int>(keys.size());
+        reports.assign(replications, std::string());
+        sketches.assign(replications, QuantileSketch());
+        results.assign(replications, SimulationResult());
+        counters.assign(static_cast<size_t>(numClients) * lockstepLanes, 0);
+        if (!keys.empty()) redraws.setSeed(keys[0].seed);   // replications differ by scenario only
+        expired.resize(numClients);
+        steps = 0;
+
+        int nextReplication = 0;
+        int running = 0;
+        for (int lane = 0; lane < lockstepLanes; ++lane) {
+            laneReplication[lane] = -1;
+            if (nextReplication < replications) {
+                loadLane(lane, nextReplication++, keys, numClients, numPackets);
+                running++;
+            }
+        }
+
+        while (running > 0) {
+            uint16_t skipped[lockstepLanes];
+            {
+                PhaseTimer timer(SimPhase::Contention);
+                skipToExpiry(counters.data(), numClients, skipped);
+            }
+            ++steps;
+
+            // Settle every lane's busy period, then redraw in one batch
+            redraws.clear();
+            for (int lane = 0; lane < lockstepLanes; ++lane) {
+                WiFi4AccessPoint& ap = lanes[lane];
+                if (laneReplication[lane] < 0 || !ap.hasTraffic()) continue;
+                ap.advanceIdleSlots(skipped[lane]);
+                size_t count = 0;
+                for (int i = 0; i < numClients; ++i) {
+                    expired[count] = static_cast<uint32_t>(i);
+                    count += (counters[i * lockstepLanes + lane] == 0) & ap.hasPacket(i);
+                }
+                redraws.setScenario(keys[laneReplication[lane]].scenario);
+                firstRedraw[lane] = ap.settleBusyPeriod(expired.data(), count, redraws);
+            }
+            redraws.generate();
+
+            for (int lane = 0; lane < lockstepLanes; ++lane) {
+                if (laneReplication[lane] < 0) continue;
+                WiFi4AccessPoint& ap = lanes[lane];
+                ap.applyRedraws(redraws, firstRedraw[lane]);
+                for (int32_t station : ap.redrawnStations()) {
+                    counters[station * lockstepLanes + lane] = ap.getBackoffInterval(station);
+                }
+                if (ap.hasTraffic()) continue;
+
+                std::ostringstream out;
+                ap.displayResults(out);
+                reports[laneReplication[lane]] = out.str();
+                sketches[laneReplication[lane]] = ap.getLatencySketch();
+                ap.fillResult(results[laneReplication[lane]]);
+                if (tracers[lane]) tracers[lane]->endRun();
+                for (int i = 0; i < numClients; ++i) {
+                    counters[i * lockstepLanes + lane] = 0;   // a run stopped early leaves counters running
+                }
+                laneReplication[lane] = -1;
+                running--;
+                if (nextReplication < replications) {
+                    loadLane(lane, nextReplication++, keys, numClients, numPackets);
+                    running++;
+                }
+            }
+        }
+        wallSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    }
+
+    const std::vector<std::string>& getReports() const { return reports; }
+    const std::vector<QuantileSketch>& getSketches() const { return sketches; }
+    const std::vector<SimulationResult>& getResults() const { return results; }
+    double getWallSeconds() const { return wallSeconds; }
+
+    void displayEngineStats(std::ostream& out, size_t replications) const {
+        out << "Engine (lockstep x" << lockstepLanes << ", "
+                  << simdLevelName(activeSimdLevel() >= SimdLevel::AVX2 ? SimdLevel::AVX2 : SimdLevel::Scalar) << "): "
+                  << replications << " replications, " << steps << " steps in " << wallSeconds * 1000 << " ms ("
+                  << (wallSeconds > 0 ? replications / wallSeconds : 0) << " replications/s)\n";
+    }
+};
+
+// WiFi 5 Access Point implementation with MU-MIMO support.
+// The AP serves up to four users per downlink transmit opportunity, one per
+// spatial stream; each user's frame is lost with the attemptToTransmit odds.
+// Queues are saturated unless an arrivals trace is replayed.
+class WiFi5AccessPoint {
+private:
+    FreqChannel channel;
+    StationTable users;
+    LatencyHistogram latencies;
+    QuantileSketch latencySketch;
+    SequentialEstimator estimator;
+    std::vector<std::pair<int, bool>> txopGroup;   // (user, frame delivered)
+    SimTime txopStart;
+    PacketTracer* tracer;                // per-packet trace, nullptr when off
+    std::vector<SimTime> firstAttempts;       // per user, for the head-of-line packet (tracing only)
+    std::vector<uint32_t> failedAttempts;
+    TrafficReplay replay;                // recorded arrivals, inactive when saturated
+    bool txopScheduled;                  // a transmit opportunity is pending or on the air
+    uint64_t transmissionAttempts;       // frames sent, one per served user and TXOP
+    size_t nextUser;
+    int usersWithTraffic;
+    double deliveredBits;
+    const int spatialStreams;
+    double transferRate;
+    const double packetSizeInBits;
+    const SimTime slotTime;
+    const SimTime sifs;
+    const SimTime difs;
+    const SimTime blockAckDuration;
+    SimTime txDuration;
+
+    EventScheduler scheduler;
+    RngKey rngKey;
+    RandomStream apRandom;
+
+    void scheduleTxop() {
+        countHotPath(HotCounter::BackoffRedraws);
+        SimTime backoff = static_cast<SimTime>(apRandom.uniformInt(16)) * slotTime;
+        scheduler.schedule(difs + backoff, TX_START, -1);
+        txopScheduled = true;
+    }
+
+    void startTxop() {
+        PhaseTimer timer(SimPhase::Contention);
+        txopGroup.clear();
+        txopStart = scheduler.now();
+        uint16_t longest = 0;
+        for (size_t scanned = 0; scanned < users.size() && txopGroup.size() < static_cast<size_t>(spatialStreams); ++scanned) {
+            size_t u = nextUser;
+            nextUser = (nextUser + 1) % users.size();
+            if (users.getPacketsLeft(u) > 0) {
+                txopGroup.emplace_back(static_cast<int>(u), users.attemptToTransmit(u, 0.1));
+                if (replay.active()) longest = std::max(longest, replay.head(u).size);
+            }
+        }
+        transmissionAttempts += txopGroup.size();
+        countHotPath(HotCounter::Attempts, txopGroup.size());
+        channel.setState(FreqChannel::OCCUPIED);
+        // Replayed frames differ in size; the streams finish with the longest
+        SimTime duration = replay.active() ? static_cast<SimTime>(longest * 8.0 / transferRate * 1e9) : txDuration;
+        scheduler.schedule(duration, TX_END, -1);
+    }
+
+    void finishTxop() {
+        PhaseTimer timer(SimPhase::Settle);
+        SimTime now = scheduler.now();
+        for (const auto& member : txopGroup) {
+            int u = member.first;
+            if (tracer) traceAttempt(u, member.second, now);
+            if (!member.second) {
+                countHotPath(HotCounter::Collisions);
+                continue;
+            }
+            countHotPath(HotCounter::Successes);
+            SimTime latency = now - users.getQueuedSince(u);
+            latencies.record(latency);
+            latencySketch.add(latency);
+            estimator.observe(static_cast<double>(latency), static_cast<double>(now));
+            if (replay.active()) {
+                deliveredBits += replay.head(u).size * 8.0;
+                replay.retire(u);
+                if (replay.queued(u) > 0) users.setQueuedSince(u, replay.head(u).arrival);
+            } else {
+                deliveredBits += packetSizeInBits;
+                users.setQueuedSince(u, now);
+            }
+            if (users.completePacket(u) == 0) {
+                usersWithTraffic--;
+            }
+        }
+        channel.setState(FreqChannel::FREE);
+        txopScheduled = false;
+        if (estimator.converged()) {
+            scheduler.stop();   // replayed arrivals would keep coming
+        } else if (usersWithTraffic > 0) {
+            scheduleTxop();
+        }
+    }
+
+    // Queues the trace's next packet and schedules the one after it; a
+    // transmit opportunity is started if the AP was idle
+    void admitArrival(SimTime now) {
+        PhaseTimer timer(SimPhase::Arrivals);
+        int32_t u = replay.admit();
+        if (u >= 0 && users.addPacket(u) == 1) {
+            users.setQueuedSince(u, now);
+            usersWithTraffic++;
+            if (!txopScheduled) scheduleTxop();
+        }
+        if (replay.pending()) scheduler.scheduleAt(replay.nextArrival(), REPLAY_ARRIVAL, -1);
+    }
+
+    // A lost frame is retried in a later transmit opportunity; the packet
+    // is traced once, when it gets through
+    void traceAttempt(int u, bool delivered, SimTime now) {
+        if (failedAttempts[u] == 0) firstAttempts[u] = txopStart;
+        if (!delivered) {
+            failedAttempts[u]++;
+            return;
+        }
+        uint16_t size = replay.active() ? replay.head(u).size : static_cast<uint16_t>(packetSizeInBits / 8);
+        tracer->record(PacketRecord{users.getQueuedSince(u), firstAttempts[u], now, static_cast<uint32_t>(u), size,
+                                    static_cast<uint8_t>(std::min<uint32_t>(failedAttempts[u], 255)), PACKET_DELIVERED});
+        failedAttempts[u] = 0;
+    }
+
+public:
+    WiFi5AccessPoint() : channel("WiFi5_Channel"),
+        txopStart(0), tracer(nullptr), txopScheduled(false), transmissionAttempts(0),
+        nextUser(0), usersWithTraffic(0), deliveredBits(0),
+        spatialStreams(4),
+        transferRate(phyRate(defaultMcs)),
+        packetSizeInBits(1024 * 8),
+        slotTime(microseconds(9)),
+        sifs(microseconds(16)),
+        difs(microseconds(34)),
+        blockAckDuration(microseconds(32)),
+        txDuration(static_cast<SimTime>(packetSizeInBits / transferRate * 1e9)) {}
+
+    void registerUser(const WiFiUser& user) {
+        users.add(user.getCollisionCount(), static_cast<uint16_t>(user.getBackoffInterval()),
+                  static_cast<uint32_t>(user.getDrawsUsed()), user.isWaitingForAccess());
+    }
+
+    void reserveUsers(size_t n) { users.reserve(n); }
+
+    void clearUsers() { users.clear(); }
+
+    // PHY rate of the data frames, by index into mcsTable
+    void setMcs(int mcs) {
+        transferRate = phyRate(mcs);
+        txDuration = static_cast<SimTime>(packetSizeInBits / transferRate * 1e9);
+    }
+
+    void setQueueBackend(QueueBackend backend) { scheduler.setBackend(backend); }
+
+    // Histogram resolution: latencies are kept to within 2^-(bits-1)
+    void setLatencyPrecision(int bits) { latencies.setPrecision(bits); }
+
+    void setStoppingRule(const StoppingRule& rule) { estimator.setRule(rule); }
+
+    // Records every delivered packet to `trace` (nullptr turns tracing off)
+    void setTracer(PacketTracer* trace) { tracer = trace; }
+
+    // Replays `trace` instead of saturated traffic (nullptr: saturated)
+    void setArrivals(const ArrivalTrace* trace) { replay.setTrace(trace); }
+
+    const QuantileSketch& getLatencySketch() const { return latencySketch; }
+    uint64_t getTransmissionAttempts() const { return transmissionAttempts; }
+
+    // Key for the AP's own stream (transmit-opportunity backoff); must match
+    // the key the users' streams were created with
+    void setRandomKey(const RngKey& key) {
+        rngKey = key;
+        users.setRandomKey(key);
+    }
+
+    void simulateMU_MIMO(int numPackets) {
+        apRandom = RandomStream(rngKey, accessPointStream);
+        latencies.clear();
+        latencySketch.clear();
+        estimator.clear();
+        deliveredBits = 0;
+        nextUser = 0;
+        scheduler.reset();
+        channel.setState(FreqChannel::FREE);
+        txopScheduled = false;
+        transmissionAttempts = 0;
+        users.resetQueues(replay.active() ? 0 : static_cast<uint32_t>(std::max(numPackets, 0)));
+        if (tracer) {
+            firstAttempts.assign(users.size(), 0);
+            failedAttempts.assign(users.size(), 0);
+        }
+        if (replay.active()) {
+            usersWithTraffic = 0;
+            replay.start();
+            if (replay.pending()) scheduler.scheduleAt(replay.nextArrival(), REPLAY_ARRIVAL, -1);
+            scheduler.run(*this);
+            return;
+        }
+        usersWithTraffic = numPackets > 0 ? static_cast<int>(users.size()) : 0;
+
+        if (usersWithTraffic > 0) {
+            scheduleTxop();
+            scheduler.run(*this);
+        }
+    }
+
+    double throughputMbps() const {
+        double duration = toSeconds(scheduler.now());
+        return duration > 0 ? deliveredBits / duration / 1e6 : 0;
+    }
+
+    void fillResult(SimulationResult& result) const {
+        result.delivered = latencies.count();
+        result.dropped = replay.active() ? replay.getTailDrops() : 0;
+        result.simulatedSeconds = toSeconds(scheduler.now());
+        result.throughputMbps = throughputMbps();
+        fillLatencyResult(result, latencies);
+    }
+
+    void displayStatistics(std::ostream& out) const {
+        out << "--- WiFi 5 MU-MIMO Simulation ---\n";
+        out << "Number of Users: " << users.size() << "\n";
+
+        double avgLatency = toMilliseconds(latencies.mean());
+        double maxLatency = toMilliseconds(latencies.max());
+
+        out << "Total Throughput: " << throughputMbps() << " Mbps\n";
+        out << "Average Latency: " << avgLatency << " ms\n";
+        out << "Max Latency: " << maxLatency << " ms\n";
+        printLatencyPercentiles(out, latencies);
+        printConfidenceIntervals(out, estimator, packetSizeInBits);
+        if (replay.active()) out << "Dropped Packets (queue full): " << replay.getTailDrops() << "\n";
+        printEngineStats(out, scheduler);
+    }
+
+    // Event dispatch, called by the scheduler
+    void handleEvent(const Event& ev) {
+        switch (ev.type) {
+        case TX_START:
+            startTxop();
+            break;
+        case TX_END:
+            scheduler.schedule(sifs + blockAckDuration, ACK, -1);
+            break;
+        case ACK:
+            finishTxop();
+            break;
+        case REPLAY_ARRIVAL:
+            admitArrival(scheduler.now());
+            break;
+        }
+    }
+};
+
+
+// WiFi 6 Access Point with OFDMA support.
+// Each downlink transmit opportunity splits the channel into up to ten
+// resource units and serves one user per unit in parallel. Queues are
+// saturated unless an arrivals trace is replayed.
+class WiFi6AccessPoint {
+private:
+    double bandwidth;
+    double bitsPerSymbol;
+    double codingRate;
+    std::vector<WiFi6User*> users;
+    FreqChannel channel;  // Add channel as a member variable
+    std::vector<SimTime> queuedSince;
+    std::vector<int> packetsLeft;
+    LatencyHistogram userLatencies;
+    QuantileSketch latencySketch;
+    SequentialEstimator estimator;
+    std::vector<int> txopGroup;
+    SimTime txopStart;
+    PacketTracer* tracer;   // per-packet trace, nullptr when off
+    TrafficReplay replay;   // recorded arrivals, inactive when saturated
+    bool txopScheduled;     // a transmit opportunity is pending or on the air
+    uint64_t transmissionAttempts;   // frames sent, one per granted resource unit
+    size_t nextUser;
+    int usersWithTraffic;
+    double deliveredBits;
+    const int resourceUnits;
+    const double packetSizeInBits;
+    const SimTime slotTime;
+    const SimTime sifs;
+    const SimTime difs;
+    const SimTime blockAckDuration;
+
+    EventScheduler scheduler;
+    RngKey rngKey;
+    RandomStream apRandom;
+
+    void scheduleTxop() {
+        countHotPath(HotCounter::BackoffRedraws);
+        SimTime backoff = static_cast<SimTime>(apRandom.uniformInt(16)) * slotTime;
+        scheduler.schedule(difs + backoff, TX_START, -1);
+        txopScheduled = true;
+    }
+
+    void startTxop() {
+        PhaseTimer timer(SimPhase::Contention);
+        txopGroup.clear();
+        txopStart = scheduler.now();
+        int units = std::min(resourceUnits, static_cast<int>(users.size()));
+        for (size_t scanned = 0; scanned < users.size() && txopGroup.size() < static_cast<size_t>(units); ++scanned) {
+            size_t u = nextUser;
+            nextUser = (nextUser + 1) % users.size();
+            if (packetsLeft[u] == 0) continue;
+            int subChannelIndex = static_cast<int>(txopGroup.size());
+            users[u]->allocateSubChannel(subChannelIndex);
+            if (users[u]->attemptTransmission(channel, subChannelIndex)) {
+                txopGroup.push_back(static_cast<int>(u));
+            } else {
+                countHotPath(HotCounter::Collisions);
+            }
+        }
+        transmissionAttempts += txopGroup.size();
+        countHotPath(HotCounter::Attempts, txopGroup.size());
+        channel.setState(FreqChannel::OCCUPIED);
+
+        // Every resource unit carries 1/units of the channel rate; replayed
+        // frames differ in size and the units finish with the longest
+        double unitRate = bandwidth * bitsPerSymbol * codingRate / units;
+        double bits = packetSizeInBits;
+        if (replay.active()) {
+            uint16_t longest = 0;
+            for (int u : txopGroup) longest = std::max(longest, replay.head(u).size);
+            bits = longest * 8.0;
+        }
+        scheduler.schedule(static_cast<SimTime>(bits / unitRate * 1e9), TX_END, -1);
+    }
+
+    void finishTxop() {
+        PhaseTimer timer(SimPhase::Settle);
+        SimTime now = scheduler.now();
+        for (int u : txopGroup) {
+            uint16_t size = replay.active() ? replay.head(u).size : static_cast<uint16_t>(packetSizeInBits / 8);
+            if (tracer) {
+                // Every granted resource unit gets through, so a packet goes out once
+                tracer->record(PacketRecord{queuedSince[u], txopStart, now, static_cast<uint32_t>(u), size, 0,
+                                            PACKET_DELIVERED});
+            }
+            countHotPath(HotCounter::Successes);
+            SimTime latency = now - queuedSince[u];
+            userLatencies.record(latency);
+            latencySketch.add(latency);
+            estimator.observe(static_cast<double>(latency), static_cast<double>(now));
+            if (replay.active()) {
+                deliveredBits += size * 8.0;
+                replay.retire(u);
+                if (replay.queued(u) > 0) queuedSince[u] = replay.head(u).arrival;
+            } else {
+                deliveredBits += packetSizeInBits;
+                queuedSince[u] = now;
+            }
+            if (--packetsLeft[u] == 0) {
+                usersWithTraffic--;
+            }
+        }
+        channel.setState(FreqChannel::FREE);
+        txopScheduled = false;
+        if (estimator.converged()) {
+            scheduler.stop();   // replayed arrivals would keep coming
+        } else if (usersWithTraffic > 0) {
+            scheduleTxop();
+        }
+    }
+
+    // Queues the trace's next packet and schedules the one after it; a
+    // transmit opportunity is started if the AP was idle
+    void admitArrival(SimTime now) {
+        PhaseTimer timer(SimPhase::Arrivals);
+        int32_t u = replay.admit();
+        if (u >= 0 && ++packetsLeft[u] == 1) {
+            queuedSince[u] = now;
+            usersWithTraffic++;
+            if (!txopScheduled) scheduleTxop();
+        }
+        if (replay.pending()) scheduler.scheduleAt(replay.nextArrival(), REPLAY_ARRIVAL, -1);
+    }
+
+public:
+    WiFi6AccessPoint(double bandwidth, double bitsPerSymbol, double codingRate)
+        : bandwidth(bandwidth), bitsPerSymbol(bitsPerSymbol), codingRate(codingRate), channel("WiFi6_Channel"),
+          txopStart(0), tracer(nullptr), txopScheduled(false), transmissionAttempts(0),
+          nextUser(0), usersWithTraffic(0), deliveredBits(0),
+          resourceUnits(10),
+          packetSizeInBits(1024 * 8),
+          slotTime(microseconds(9)),
+          sifs(microseconds(16)),
+          difs(microseconds(34)),
+          blockAckDuration(microseconds(32)) {}
+
+    void registerUser(WiFi6User* user) {
+        users.push_back(user);
+    }
+
+    void clearUsers() { users.clear(); }
+
+    // Modulation and coding of every resource unit, by index into mcsTable
+    void setMcs(int mcs) {
+        bitsPerSymbol = mcsTable[mcs].bitsPerSymbol;
+        codingRate = mcsTable[mcs].codingRate;
+    }
+
+    void setQueueBackend(QueueBackend backend) { scheduler.setBackend(backend); }
+
+    // Histogram resolution: latencies are kept to within 2^-(bits-1)
+    void setLatencyPrecision(int bits) { userLatencies.setPrecision(bits); }
+
+    void setStoppingRule(const StoppingRule& rule) { estimator.setRule(rule); }
+
+    // Records every delivered packet to `trace` (nullptr turns tracing off)
+    void setTracer(PacketTracer* trace) { tracer = trace; }
+
+    // Replays `trace` instead of saturated traffic (nullptr: saturated)
+    void setArrivals(const ArrivalTrace* trace) { replay.setTrace(trace); }
+
+    const QuantileSketch& getLatencySketch() const { return latencySketch; }
+    uint64_t getTransmissionAttempts() const { return transmissionAttempts; }
+
+    // Key for the AP's own stream (transmit-opportunity backoff)
+    void setRandomKey(const RngKey& key) { rngKey = key; }
+
+    void simulateOFDMA(int numPackets) {
+        apRandom = RandomStream(rngKey, accessPointStream);
+        userLatencies.clear();
+        latencySketch.clear();
+        estimator.clear();
+        deliveredBits = 0;
+        nextUser = 0;
+        scheduler.reset();
+        channel.setState(FreqChannel::FREE);
+        txopScheduled = false;
+        transmissionAttempts = 0;
+        queuedSince.assign(users.size(), 0);
+        packetsLeft.assign(users.size(), replay.active() ? 0 : std::max(numPackets, 0));
+        if (replay.active()) {
+            usersWithTraffic = 0;
+            replay.start();
+            if (replay.pending()) scheduler.scheduleAt(replay.nextArrival(), REPLAY_ARRIVAL, -1);
+            scheduler.run(*this);
+            return;
+        }
+        usersWithTraffic = numPackets > 0 ? static_cast<int>(users.size()) : 0;
+
+        if (usersWithTraffic > 0) {
+            scheduleTxop();
+            scheduler.run(*this);
+        }
+    }
+
+    double throughputMbps() const {
+        double duration = toSeconds(scheduler.now());
+        return duration > 0 ? deliveredBits / duration / 1e6 : 0;
+    }
+
+    void fillResult(SimulationResult& result) const {
+        result.delivered = userLatencies.count();
+        result.dropped = replay.active() ? replay.getTailDrops() : 0;
+        result.simulatedSeconds = toSeconds(scheduler.now());
+        result.throughputMbps = throughputMbps();
+        fillLatencyResult(result, userLatencies);
+    }
+
+    void displayStatistics(std::ostream& out) const {
+        double avgLatency = toMilliseconds(userLatencies.mean());
+        double maxLatency = toMilliseconds(userLatencies.max());
+
+        out << "Total Throughput: " << throughputMbps() << " Mbps\n";
+        out << "Average Latency: " << avgLatency << " ms\n";
+        out << "Max Latency: " << maxLatency << " ms\n";
+        printLatencyPercentiles(out, userLatencies);
+        printConfidenceIntervals(out, estimator, packetSizeInBits);
+        if (replay.active()) out << "Dropped Packets (queue full): " << replay.getTailDrops() << "\n";
+        printEngineStats(out, scheduler);
+    }
+
+    // Event dispatch, called by the scheduler
+    void handleEvent(const Event& ev) {
+        switch (ev.type) {
+        case TX_START:
+            startTxop();
+            break;
+        case TX_END:
+            scheduler.schedule(sifs + blockAckDuration, ACK, -1);
+            break;
+        case ACK:
+            finishTxop();
+            break;
+        case REPLAY_ARRIVAL:
+            admitArrival(scheduler.now());
+            break;
+        }
+    }
+};
+
+#endif
@@ -0,0 +1,828 @@
+#include <iostream>
+#include <iomanip>
+#include <fstream>
+#include <sstream>
+#include <vector>
+#include <random>
+#include <chrono>
+#include <string>
+#include <atomic>
+#include <map>
+#include <cctype>
+#include <cmath>
+#include <stdexcept>
+#include <new>
+#include <cstdlib>
+
+#include <sys/resource.h>
+
+#include "access_points.h"
+#include "contention_kernel.h"
+#include "rng.h"
+#include "sim_engine.h"
+#include "station_table.h"
+#include "trace_codec.h"
+#include "wifi_user.h"
+
+using namespace std;
+
+// Micro-benchmarks for the simulator's building blocks, and end-to-end
+// runs of the three access points written as JSON
+
+// Every heap allocation in the process is counted, so a benchmark can
+// report how many its measured section made
+static atomic<uint64_t> heapAllocations{0};
+
+// Every replaceable form below allocates here and frees with release(), so
+// the whole set is backed by malloc/free and no form is left to the
+// library's allocator
+static void* countedAllocate(size_t size, size_t alignment) {
+    heapAllocations.fetch_add(1, memory_order_relaxed);
+    if (size == 0) size = 1;
+    if (alignment <= alignof(max_align_t)) return malloc(size);
+    return aligned_alloc(alignment, (size + alignment - 1) / alignment * alignment);
+}
+
+static void release(void* p) noexcept { free(p); }
+
+static void* countedAllocateOrThrow(size_t size, size_t alignment) {
+    if (void* p = countedAllocate(size, alignment)) return p;
+    throw bad_alloc();
+}
+
+void* operator new(size_t size) { return countedAllocateOrThrow(size, 0); }
+void* operator new[](size_t size) { return countedAllocateOrThrow(size, 0); }
+void* operator new(size_t size, const nothrow_t&) noexcept { return countedAllocate(size, 0); }
+void* operator new[](size_t size, const nothrow_t&) noexcept { return countedAllocate(size, 0); }
+void* operator new(size_t size, align_val_t alignment) {
+    return countedAllocateOrThrow(size, static_cast<size_t>(alignment));
+}
+void* operator new[](size_t size, align_val_t alignment) {
+    return countedAllocateOrThrow(size, static_cast<size_t>(alignment));
+}
+void* operator new(size_t size, align_val_t alignment, const nothrow_t&) noexcept {
+    return countedAllocate(size, static_cast<size_t>(alignment));
+}
+void* operator new[](size_t size, align_val_t alignment, const nothrow_t&) noexcept {
+    return countedAllocate(size, static_cast<size_t>(alignment));
+}
+
+void operator delete(void* p) noexcept { release(p); }
+void operator delete[](void* p) noexcept { release(p); }
+void operator delete(void* p, size_t) noexcept { release(p); }
+void operator delete[](void* p, size_t) noexcept { release(p); }
+void operator delete(void* p, const nothrow_t&) noexcept { release(p); }
+void operator delete[](void* p, const nothrow_t&) noexcept { release(p); }
+void operator delete(void* p, align_val_t) noexcept { release(p); }
+void operator delete[](void* p, align_val_t) noexcept { release(p); }
+void operator delete(void* p, size_t, align_val_t) noexcept { release(p); }
+void operator delete[](void* p, size_t, align_val_t) noexcept { release(p); }
+void operator delete(void* p, align_val_t, const nothrow_t&) noexcept { release(p); }
+void operator delete[](void* p, align_val_t, const nothrow_t&) noexcept { release(p); }
+
+// Slot-aligned delays as the MAC produces them: DIFS plus a backoff of up to
+// 1023 slots, or a full DATA + SIFS + ACK exchange
+static vector<SimTime> makeDelays(size_t n) {
+    mt19937_64 gen(42);
+    vector<SimTime> delays(n);
+    for (auto& d : delays) {
+        if (gen() % 4 == 0) {
+            d = nanoseconds(61440) + microseconds(16 + 32);
+        } else {
+            d = microseconds(34) + static_cast<SimTime>(gen() % 1024) * microseconds(9);
+        }
+    }
+    return delays;
+}
+
+// Classic hold model: keep `pending` events queued and repeatedly pop the
+// earliest one and push a successor. Returns ns per pop + push pair.
+template <class Queue>
+static double holdBenchmark(size_t pending, size_t operations, const vector<SimTime>& delays, uint64_t& checksum) {
+    Queue queue;
+    uint64_t seq = 0;
+    size_t d = 0;
+    for (size_t i = 0; i < pending; ++i) {
+        queue.push(Event{delays[d++ % delays.size()], seq++, static_cast<int32_t>(i), 0, 0});
+    }
+
+    auto start = chrono::steady_clock::now();
+    for (size_t i = 0; i < operations; ++i) {
+        Event ev = queue.pop();
+        checksum = checksum * 31 + static_cast<uint64_t>(ev.target);
+        queue.push(Event{ev.time + delays[d++ % delays.size()], seq++, ev.target, 0, 0});
+    }
+    double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    return seconds * 1e9 / operations;
+}
+
+static void benchmarkEventQueues() {
+    cout << "Event queue hold benchmark (ns per pop + push)\n";
+    cout << setw(10) << "pending" << setw(16) << queueBackendName(QueueBackend::BinaryHeap)
+         << setw(16) << queueBackendName(QueueBackend::TimingWheel) << setw(10) << "speedup" << "\n";
+
+    const vector<SimTime> delays = makeDelays(1 << 16);
+    for (size_t pending : {1000, 10000, 100000}) {
+        const size_t operations = 5000000;
+        uint64_t heapOrder = 0, wheelOrder = 0;
+        double heapNs = holdBenchmark<HeapEventQueue>(pending, operations, delays, heapOrder);
+        double wheelNs = holdBenchmark<TimingWheelEventQueue>(pending, operations, delays, wheelOrder);
+
+        cout << setw(10) << pending << fixed << setprecision(1)
+             << setw(16) << heapNs << setw(16) << wheelNs
+             << setprecision(2) << setw(9) << heapNs / wheelNs << "x"
+             << (heapOrder == wheelOrder ? "" : "  (pop order differs!)") << "\n";
+        cout.unsetf(ios::fixed);
+    }
+}
+
+// Batched Philox draws at every SIMD level the CPU offers, cross-checked
+// against the scalar path
+static void benchmarkRandomDraws() {
+    const size_t n = 1 << 16;
+    const int rounds = 200;
+    const RngKey key{7, scenarioId(4, 1000, 1000)};
+    vector<uint32_t> streams(n), draws(n);
+    for (size_t i = 0; i < n; ++i) {
+        streams[i] = static_cast<uint32_t>(i % 1000);
+        draws[i] = static_cast<uint32_t>(i / 1000);
+    }
+
+    cout << "\nBatched Philox4x32-10 draws (" << n << " per batch)\n";
+    cout << setw(10) << "path" << setw(16) << "draws/ns" << setw(10) << "speedup" << "\n";
+
+    const SimdLevel saved = simdLevelLimit();
+    vector<uint32_t> reference(n), out(n);
+    double scalarRate = 0;
+    for (SimdLevel level : {SimdLevel::Scalar, SimdLevel::AVX2, SimdLevel::AVX512}) {
+        simdLevelLimit() = level;
+        if (activeSimdLevel() != level) continue;   // not supported here
+
+        auto start = chrono::steady_clock::now();
+        for (int r = 0; r < rounds; ++r) {
+            draws[0] = static_cast<uint32_t>(r);    // keep rounds distinct
+            counterDrawBatch(key, streams.data(), draws.data(), out.data(), n);
+        }
+        double ns = chrono::duration<double, nano>(chrono::steady_clock::now() - start).count();
+        double rate = static_cast<double>(n) * rounds / ns;
+        if (level == SimdLevel::Scalar) {
+            scalarRate = rate;
+            reference = out;
+        }
+
+        cout << setw(10) << simdLevelName(level) << fixed << setprecision(3) << setw(16) << rate
+             << setprecision(2) << setw(9) << rate / scalarRate << "x"
+             << (out == reference ? "" : "  (differs from scalar!)") << "\n";
+        cout.unsetf(ios::fixed);
+    }
+    simdLevelLimit() = saved;
+}
+
+// Runs `slots` contention slots on a table: the kernel counts every backoff
+// down, then expired stations are redrawn as a success or a collision would
+// redraw them. Returns ns per station-slot.
+static double countdownBenchmark(StationTable& table, size_t slots) {
+    vector<uint32_t> expired(table.size());
+    auto start = chrono::steady_clock::now();
+    for (size_t slot = 0; slot < slots; ++slot) {
+        size_t count = countdownSlot(table.backoffData(), table.size(), expired.data());
+        for (size_t k = 0; k < count; ++k) {
+            uint32_t station = expired[k];
+            if (count > 1) {
+                table.widenContentionWindow(station);
+            } else {
+                table.registerSuccess(station);
+            }
+            table.resetBackoffInterval(station);
+        }
+    }
+    double ns = chrono::duration<double, nano>(chrono::steady_clock::now() - start).count();
+    return ns / (static_cast<double>(slots) * table.size());
+}
+
+// One contention slot across N stations: the per-object
+// WiFiUser::attemptToTransmit loop against the countdown kernel on the
+// structure-of-arrays table at every SIMD level (make test checks that the
+// levels agree). The speedup is the fastest level's.
+static void benchmarkContentionSlots() {
+    cout << "\nContention slot (ns per station per slot)\n";
+    cout << setw(10) << "stations" << setw(16) << "attempt loop";
+    for (SimdLevel level : {SimdLevel::Scalar, SimdLevel::AVX2, SimdLevel::AVX512}) {
+        cout << setw(12) << simdLevelName(level);
+    }
+    cout << setw(10) << "speedup" << "\n";
+
+    const SimdLevel saved = simdLevelLimit();
+    for (size_t stations : {100, 10000, 1000000}) {
+        RngKey key{7, scenarioId(4, static_cast<uint32_t>(stations), 0)};
+
+        vector<WiFiUser> users;
+        users.reserve(stations);
+        for (size_t i = 0; i < stations; ++i) users.emplace_back(static_cast<int>(i), key);
+        const size_t loopSlots = max<size_t>(1, 20000000 / stations);
+        size_t delivered = 0;
+        auto start = chrono::steady_clock::now();
+        for (size_t slot = 0; slot < loopSlots; ++slot) {
+            for (WiFiUser& user : users) delivered += user.attemptToTransmit(0.1);
+        }
+        double loopNs = chrono::duration<double, nano>(chrono::steady_clock::now() - start).count() /
+                        (static_cast<double>(loopSlots) * stations);
+
+        StationTable initial;
+        initial.setRandomKey(key);
+        initial.reserve(stations);
+        for (size_t i = 0; i < stations; ++i) {
+            WiFiUser user(static_cast<int>(i), key);
+            initial.add(0, static_cast<uint16_t>(user.getBackoffInterval()), static_cast<uint32_t>(user.getDrawsUsed()), false);
+        }
+
+        cout << setw(10) << stations << fixed << setprecision(3) << setw(16) << loopNs;
+        const size_t kernelSlots = max<size_t>(1, 200000000 / stations);
+        double bestNs = 0;
+        for (SimdLevel level : {SimdLevel::Scalar, SimdLevel::AVX2, SimdLevel::AVX512}) {
+            simdLevelLimit() = level;
+            if (activeSimdLevel() != level) {
+                cout << setw(12) << "-";   // not supported here
+                continue;
+            }
+            StationTable table = initial;
+            double ns = countdownBenchmark(table, kernelSlots);
+            bestNs = bestNs == 0 ? ns : min(bestNs, ns);
+            cout << setw(12) << ns;
+        }
+        cout << setprecision(1) << setw(9) << loopNs / bestNs << "x"
+             << (delivered ? "" : "  (no deliveries)") << "\n";
+        cout.unsetf(ios::fixed);
+    }
+    simdLevelLimit() = saved;
+}
+
+// Saturated-DCF-like packet records for `stations` stations: exchanges of
+// about 143 us separated by random backoffs, collisions sharing a
+// completion time, geometric retries with drops at the limit
+static vector<PacketRecord> makeTrace(size_t stations, size_t n) {
+    mt19937_64 gen(11);
+    vector<PacketRecord> records(n);
+    vector<SimTime> lastCompletion(stations, 0);
+    SimTime now = 0;
+    for (PacketRecord& r : records) {
+        if (gen() % 8 != 0) now += nanoseconds(143439) + static_cast<SimTime>(gen() % 32) * microseconds(9);
+        r.station = static_cast<uint32_t>(gen() % stations);
+        r.retries = 0;
+        while (r.retries < 7 && gen() % 2) r.retries++;
+        r.outcome = r.retries == 7 ? PACKET_DROPPED : PACKET_DELIVERED;
+        r.size = 1024;
+        r.completionTime = now;
+        r.enqueueTime = lastCompletion[r.station];
+        r.firstAttempt = r.retries ? r.enqueueTime + static_cast<SimTime>(gen() % 2000000) : now - nanoseconds(109439);
+        lastCompletion[r.station] = now;
+    }
+    return records;
+}
+
+static void benchmarkTraceCodec() {
+    cout << "\nCompact trace encoding (32-byte records)\n";
+    cout << setw(10) << "stations" << setw(16) << "bytes/record" << setw(14) << "encode ns" << setw(14) << "decode ns"
+         << setw(16) << "decode MB/s" << setw(14) << "raw GB/s" << setw(10) << "exact" << "\n";
+    const size_t n = 4000000;
+    for (size_t stations : {10, 100, 1000}) {
+        vector<PacketRecord> records = makeTrace(stations, n);
+        vector<uint8_t> encoded(n * maxEncodedRecord);
+
+        auto start = chrono::steady_clock::now();
+        TraceEncoder encoder;
+        uint8_t* out = encoded.data();
+        for (const PacketRecord& r : records) out = encoder.encode(out, r);
+        double encodeNs = chrono::duration<double, nano>(chrono::steady_clock::now() - start).count() / n;
+        size_t bytes = static_cast<size_t>(out - encoded.data());
+
+        // Streaming decode, as a scan consumes it
+        start = chrono::steady_clock::now();
+        TraceDecoder decoder;
+        decoder.begin(static_cast<uint32_t>(stations));
+        const uint8_t* in = encoded.data();
+        PacketRecord r;
+        int64_t checksum = 0;
+        for (size_t i = 0; i < n; ++i) {
+            in = decoder.decode(in, out, r);
+            checksum += r.completionTime - r.enqueueTime + r.firstAttempt + r.station + r.retries;
+        }
+        double decodeSeconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+        decoder.begin(static_cast<uint32_t>(stations));
+        in = encoded.data();
+        bool exact = true;
+        for (const PacketRecord& a : records) {
+            in = decoder.decode(in, out, r);
+            exact &= a.completionTime == r.completionTime && a.enqueueTime == r.enqueueTime &&
+                     a.firstAttempt == r.firstAttempt && a.station == r.station && a.retries == r.retries &&
+                     a.outcome == r.outcome && a.size == r.size;
+            checksum -= a.completionTime - a.enqueueTime + a.firstAttempt + a.station + a.retries;
+        }
+        exact &= checksum == 0;
+
+        cout << setw(10) << stations << fixed << setprecision(2) << setw(16) << static_cast<double>(bytes) / n
+             << setw(14) << encodeNs << setw(14) << decodeSeconds * 1e9 / n << setw(16) << setprecision(0)
+             << bytes / decodeSeconds / 1e6 << setw(14) << setprecision(2) << n * sizeof(PacketRecord) / decodeSeconds / 1e9
+             << setw(10) << (exact ? "yes" : "NO") << "\n";
+        cout.unsetf(ios::fixed);
+    }
+}
+
+// Peak resident set size in KiB since the last resetPeakRss(). Linux keeps
+// the peak in VmHWM; elsewhere it is the process-wide getrusage() peak.
+static void resetPeakRss() {
+    ofstream clear("/proc/self/clear_refs");
+    clear << "5";
+}
+
+static long peakRssKb() {
+    ifstream status("/proc/self/status");
+    string line;
+    while (getline(status, line)) {
+        if (line.compare(0, 6, "VmHWM:") == 0) return stol(line.substr(6));
+    }
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return usage.ru_maxrss;
+}
+
+struct SimulatorBenchmark {
+    int generation;
+    int clients;
+    int packetsPerClient;
+    uint64_t attempts;        // frames put on the air, per run
+    uint64_t finished;        // packets delivered or dropped, per run
+    vector<double> samples;   // wall seconds of each measured run
+    double seconds;           // median of the samples
+    double allocations;       // heap allocations per run
+    long peakRssKb;
+};
+
+static double median(vector<double> values) {
+    if (values.empty()) return 0;
+    sort(values.begin(), values.end());
+    size_t half = values.size() / 2;
+    return values.size() % 2 ? values[half] : (values[half - 1] + values[half]) / 2;
+}
+
+// Runs one access point on a cell: a first run sizes its tables and queues,
+// then `runs` reused runs are timed, as a sweep worker reuses its access
+// points. Allocations are counted over the reused runs only.
+template <class Setup, class Simulate, class Attempts>
+static SimulatorBenchmark timeSimulator(int generation, int clients, int packets, int runs, Setup setup,
+                                        Simulate simulate, Attempts attempts) {
+    SimulatorBenchmark b{generation, clients, packets, 0, 0, {}, 0, 0, 0};
+    resetPeakRss();
+    setup();
+    simulate();
+    uint64_t allocationsBefore = heapAllocations.load(memory_order_relaxed);
+    for (int run = 0; run < runs; ++run) {
+        auto start = chrono::steady_clock::now();
+        SimulationResult result = simulate();
+        b.samples.push_back(chrono::duration<double>(chrono::steady_clock::now() - start).count());
+        b.attempts = attempts();
+        b.finished = result.delivered + result.dropped;
+    }
+    b.seconds = median(b.samples);
+    b.allocations = static_cast<double>(heapAllocations.load(memory_order_relaxed) - allocationsBefore) / runs;
+    b.peakRssKb = peakRssKb();
+    return b;
+}
+
+static vector<SimulatorBenchmark> benchmarkSimulators(int runs) {
+    vector<SimulatorBenchmark> results;
+    for (int clients : {1, 10, 100, 1000, 10000}) {
+        // About 200k packets per cell, at least 20 per client
+        const int packets = max(20, 200000 / clients);
+        const RngKey key{7, scenarioId(4, static_cast<uint32_t>(clients), static_cast<uint32_t>(packets))};
+
+        WiFi4AccessPoint wifi4;
+        results.push_back(timeSimulator(4, clients, packets, runs,
+            [&] {
+                wifi4.setRandomKey(key);
+                wifi4.reserveClients(clients);
+                for (int i = 0; i < clients; ++i) wifi4.addClient(WiFiUser(i, key));
+            },
+            [&] {
+                SimulationResult result;
+                wifi4.simulateNetwork(packets);
+                wifi4.fillResult(result);
+                return result;
+            },
+            [&] { return wifi4.getTransmissionAttempts(); }));
+
+        WiFi5AccessPoint wifi5;
+        results.push_back(timeSimulator(5, clients, packets, runs,
+            [&] {
+                wifi5.setRandomKey(key);
+                wifi5.reserveUsers(clients);
+                for (int i = 0; i < clients; ++i) wifi5.registerUser(WiFiUser(i, key));
+            },
+            [&] {
+                SimulationResult result;
+                wifi5.simulateMU_MIMO(packets);
+                wifi5.fillResult(result);
+                return result;
+            },
+            [&] { return wifi5.getTransmissionAttempts(); }));
+
+        WiFi6AccessPoint wifi6(20e6, 8.0, 5.0 / 6.0);
+        vector<WiFi6User> users;
+        results.push_back(timeSimulator(6, clients, packets, runs,
+            [&] {
+                wifi6.setRandomKey(key);
+                users.reserve(clients);
+                for (int i = 0; i < clients; ++i) users.emplace_back(i);
+                for (WiFi6User& user : users) wifi6.registerUser(&user);
+            },
+            [&] {
+                SimulationResult result;
+                wifi6.simulateOFDMA(packets);
+                wifi6.fillResult(result);
+                return result;
+            },
+            [&] { return wifi6.getTransmissionAttempts(); }));
+    }
+    return results;
+}
+
+// Events per wall second of the event-driven WiFi 4 access point with the
+// default queue at 100 clients, the median over `runs` reused runs. This is
+// the cell the engine's 10 M events/s target is set for.
+static double benchmarkEngineRate(int runs) {
+    const int clients = 100, packets = 2000;
+    const RngKey key{7, scenarioId(4, clients, packets)};
+    WiFi4AccessPoint wifi4;
+    wifi4.setRandomKey(key);
+    wifi4.reserveClients(clients);
+    for (int i = 0; i < clients; ++i) wifi4.addClient(WiFiUser(i, key));
+    wifi4.simulateNetwork(packets);
+    vector<double> rates;
+    for (int run = 0; run < runs; ++run) {
+        wifi4.simulateNetwork(packets);
+        rates.push_back(wifi4.getScheduler().eventsPerSecond());
+    }
+    return median(rates);
+}
+
+// Bytes per station of a WiFi 4 access point's station-sized state after
+// a run at `clients` stations with one packet each (enough to size every
+// list; a million stations take a few seconds event-driven)
+static double stationFootprint(int clients, bool slotted) {
+    const RngKey key{7, scenarioId(4, clients, 1)};
+    WiFi4AccessPoint wifi4;
+    wifi4.setRandomKey(key);
+    wifi4.reserveClients(clients);
+    for (int i = 0; i < clients; ++i) wifi4.addClient(WiFiUser(i, key));
+    if (slotted) {
+        wifi4.simulateSlotted(1);
+    } else {
+        wifi4.simulateNetwork(1);
+    }
+    return static_cast<double>(wifi4.stationMemoryBytes()) / clients;
+}
+
+static string cpuModel() {
+    ifstream cpuinfo("/proc/cpuinfo");
+    string line;
+    while (getline(cpuinfo, line)) {
+        if (line.compare(0, 10, "model name") == 0) return line.substr(line.find(':') + 2);
+    }
+    return "unknown";
+}
+
+static string jsonString(const string& text) {
+    string quoted = "\"";
+    for (char c : text) {
+        if (c == '"' || c == '\\') quoted += '\\';
+        quoted += c;
+    }
+    return quoted + "\"";
+}
+
+// One object per cell, with the host so that runs on different machines
+// are not compared by mistake
+static void writeSimulatorJson(ostream& out, const vector<SimulatorBenchmark>& results) {
+    out << "{\n  \"benchmark\": \"simulators\",\n"
+        << "  \"host\": {\"cpu\": " << jsonString(cpuModel()) << ", \"simd\": \"" << simdLevelName(activeSimdLevel())
+        << "\", \"compiler\": " << jsonString(__VERSION__) << "},\n  \"results\": [\n";
+    out << setprecision(9);
+    for (size_t i = 0; i < results.size(); ++i) {
+        const SimulatorBenchmark& b = results[i];
+        out << "    {\"generation\": " << b.generation << ", \"clients\": " << b.clients
+            << ", \"packets_per_client\": " << b.packetsPerClient << ", \"attempts\": " << b.attempts
+            << ", \"packets\": " << b.finished << ", \"wall_s\": " << b.seconds
+            << ", \"ns_per_attempt\": " << (b.attempts ? b.seconds * 1e9 / b.attempts : 0)
+            << ", \"packets_per_s\": " << (b.seconds > 0 ? b.finished / b.seconds : 0)
+            << ", \"allocations_per_packet\": " << (b.finished ? b.allocations / b.finished : 0)
+            << ", \"peak_rss_kb\": " << b.peakRssKb << ", \"samples_wall_s\": [";
+        for (size_t k = 0; k < b.samples.size(); ++k) out << (k ? ", " : "") << b.samples[k];
+        out << "]}" << (i + 1 < results.size() ? "," : "") << "\n";
+    }
+    out << "  ]\n}\n";
+}
+
+static void printSimulatorSummary(ostream& out, const vector<SimulatorBenchmark>& results) {
+    out << "\nAccess points, end to end (median of " << (results.empty() ? 0 : results[0].samples.size())
+        << " reused runs)\n";
+    out << setw(6) << "WiFi" << setw(10) << "clients" << setw(16) << "ns/attempt" << setw(16) << "packets/s"
+        << setw(14) << "allocs/pkt" << setw(14) << "peak RSS MB" << "\n";
+    for (const SimulatorBenchmark& b : results) {
+        out << setw(6) << b.generation << setw(10) << b.clients << fixed << setprecision(1) << setw(16)
+            << (b.attempts ? b.seconds * 1e9 / b.attempts : 0) << setprecision(0) << setw(16)
+            << (b.seconds > 0 ? b.finished / b.seconds : 0) << setprecision(4) << setw(14)
+            << (b.finished ? b.allocations / b.finished : 0) << setprecision(1) << setw(14) << b.peakRssKb / 1024.0
+            << "\n";
+        out.unsetf(ios::fixed);
+    }
+}
+
+// Just enough JSON to read bench.json back: objects, arrays, strings,
+// numbers, true, false and null
+struct JsonValue {
+    enum Kind { Null, Boolean, Number, String, Array, Object } kind = Null;
+    double number = 0;
+    string text;
+    vector<JsonValue> items;
+    vector<pair<string, JsonValue>> fields;
+
+    const JsonValue* find(const string& key) const {
+        for (const auto& field : fields) {
+            if (field.first == key) return &field.second;
+        }
+        return nullptr;
+    }
+
+    const JsonValue& at(const string& key) const {
+        const JsonValue* value = find(key);
+        if (!value) throw invalid_argument("missing \"" + key + "\"");
+        return *value;
+    }
+};
+
+class JsonParser {
+private:
+    const string& in;
+    size_t pos;
+
+    void skipSpace() {
+        while (pos < in.size() && isspace(static_cast<unsigned char>(in[pos]))) ++pos;
+    }
+
+    void expect(char c) {
+        skipSpace();
+        if (pos >= in.size() || in[pos] != c) {
+            throw invalid_argument(string("expected '") + c + "' at byte " + to_string(pos));
+        }
+        ++pos;
+    }
+
+    string parseString() {
+        expect('"');
+        string text;
+        while (pos < in.size() && in[pos] != '"') {
+            if (in[pos] == '\\' && pos + 1 < in.size()) ++pos;
+            text += in[pos++];
+        }
+        expect('"');
+        return text;
+    }
+
+public:
+    explicit JsonParser(const string& text) : in(text), pos(0) {}
+
+    JsonValue parse() {
+        JsonValue value;
+        skipSpace();
+        if (pos >= in.size()) throw invalid_argument("unexpected end of JSON");
+        char c = in[pos];
+        if (c == '{') {
+            value.kind = JsonValue::Object;
+            ++pos;
+            skipSpace();
+            if (pos < in.size() && in[pos] == '}') return ++pos, value;
+            do {
+                string key = parseString();
+                expect(':');
+                value.fields.emplace_back(key, parse());
+                skipSpace();
+            } while (pos < in.size() && in[pos] == ',' && ++pos);
+            expect('}');
+        } else if (c == '[') {
+            value.kind = JsonValue::Array;
+            ++pos;
+            skipSpace();
+            if (pos < in.size() && in[pos] == ']') return ++pos, value;
+            do {
+                value.items.push_back(parse());
+                skipSpace();
+            } while (pos < in.size() && in[pos] == ',' && ++pos);
+            expect(']');
+        } else if (c == '"') {
+            value.kind = JsonValue::String;
+            value.text = parseString();
+        } else if (in.compare(pos, 4, "true") == 0 || in.compare(pos, 5, "false") == 0) {
+            value.kind = JsonValue::Boolean;
+            value.number = in[pos] == 't';
+            pos += in[pos] == 't' ? 4 : 5;
+        } else if (in.compare(pos, 4, "null") == 0) {
+            pos += 4;
+        } else {
+            size_t used = 0;
+            try {
+                value.number = stod(in.substr(pos, 32), &used);
+            } catch (const exception&) {
+                throw invalid_argument("unexpected '" + string(1, c) + "' at byte " + to_string(pos));
+            }
+            value.kind = JsonValue::Number;
+            pos += used;
+        }
+        return value;
+    }
+};
+
+static JsonValue readJsonFile(const string& path) {
+    ifstream in(path);
+    if (!in) throw invalid_argument("cannot open " + path);
+    stringstream text;
+    text << in.rdbuf();
+    try {
+        return JsonParser(text.str()).parse();
+    } catch (const invalid_argument& e) {
+        throw invalid_argument(path + ": " + e.what());
+    }
+}
+
+// One cell of a bench.json, as the comparison needs it
+struct BenchmarkSamples {
+    vector<double> nsPerAttempt;   // one per measured run
+    double allocationsPerPacket;
+    double peakRssKb;
+};
+
+static map<pair<int, int>, BenchmarkSamples> readSimulatorSamples(const string& path, string& cpu) {
+    JsonValue root = readJsonFile(path);
+    map<pair<int, int>, BenchmarkSamples> cells;
+    try {
+        if (const JsonValue* host = root.find("host")) cpu = host->at("cpu").text;
+        for (const JsonValue& r : root.at("results").items) {
+            BenchmarkSamples cell;
+            double attempts = r.at("attempts").number;
+            for (const JsonValue& sample : r.at("samples_wall_s").items) {
+                cell.nsPerAttempt.push_back(attempts > 0 ? sample.number * 1e9 / attempts : 0);
+            }
+            cell.allocationsPerPacket = r.at("allocations_per_packet").number;
+            cell.peakRssKb = r.at("peak_rss_kb").number;
+            cells[make_pair(static_cast<int>(r.at("generation").number), static_cast<int>(r.at("clients").number))] = cell;
+        }
+    } catch (const invalid_argument& e) {
+        throw invalid_argument(path + ": " + e.what());
+    }
+    return cells;
+}
+
+// Compares two bench.json files cell by cell. A cell is reported faster or
+// slower only when a two-sided Mann-Whitney U test on the per-run ns per
+// attempt rejects "same distribution" at `alpha` and the medians differ by
+// more than `threshold` (relative), so run-to-run noise reads as unchanged.
+// Returns 2 when some cell got significantly slower.
+static int compareBenchmarks(const string& basePath, const string& newPath, double alpha, double threshold) {
+    string baseCpu, newCpu;
+    map<pair<int, int>, BenchmarkSamples> base = readSimulatorSamples(basePath, baseCpu);
+    map<pair<int, int>, BenchmarkSamples> next = readSimulatorSamples(newPath, newCpu);
+    if (baseCpu != newCpu) {
+        cout << "Warning: the runs are from different CPUs (" << baseCpu << " vs " << newCpu << ")\n";
+    }
+    cout << "Access points: " << basePath << " -> " << newPath << " (median ns per attempt, Mann-Whitney U, alpha "
+         << alpha << ", threshold " << threshold * 100 << "%)\n";
+    cout << setw(6) << "WiFi" << setw(10) << "clients" << setw(12) << "base" << setw(12) << "new" << setw(10)
+         << "speedup" << setw(10) << "p" << setw(10) << "verdict" << setw(22) << "allocs/pkt" << setw(20)
+         << "peak RSS MB" << "\n";
+    int slower = 0, faster = 0;
+    for (const auto& entry : base) {
+        auto match = next.find(entry.first);
+        if (match == next.end()) continue;
+        const BenchmarkSamples& a = entry.second;
+        const BenchmarkSamples& b = match->second;
+        double before = median(a.nsPerAttempt), after = median(b.nsPerAttempt);
+        RankSumTest test = mannWhitneyU(a.nsPerAttempt, b.nsPerAttempt);
+        const char* verdict = "same";
+        if (test.pValue < alpha && fabs(after - before) > threshold * before) {
+            verdict = after < before ? "faster" : "SLOWER";
+            (after < before ? faster : slower)++;
+        }
+        ostringstream allocations, rss;
+        allocations << fixed << setprecision(3) << a.allocationsPerPacket << " -> " << b.allocationsPerPacket;
+        rss << fixed << setprecision(1) << a.peakRssKb / 1024 << " -> " << b.peakRssKb / 1024;
+        cout << setw(6) << entry.first.first << setw(10) << entry.first.second << fixed << setprecision(1)
+             << setw(12) << before << setw(12) << after << setprecision(3) << setw(9)
+             << (after > 0 ? before / after : 0) << "x" << setprecision(4) << setw(10) << test.pValue << setw(10)
+             << verdict << setw(22) << allocations.str() << setw(20) << rss.str() << "\n";
+        cout.unsetf(ios::fixed);
+    }
+    cout << faster << " faster, " << slower << " slower, " << base.size() - faster - slower << " unchanged\n";
+    if (!base.empty() && !next.empty() && mannWhitneyU(vector<double>(base.begin()->second.nsPerAttempt.size(), 0),
+                                      vector<double>(next.begin()->second.nsPerAttempt.size(), 1)).pValue >= alpha) {
+        cout << "Too few samples per cell for any difference to reach alpha " << alpha << "; rerun with more --samples\n";
+    }
+    return slower > 0 ? 2 : 0;
+}
+
+int main(int argc, char* argv[]) {
+    if (argc >= 4 && string(argv[1]) == "compare") {
+        double alpha = 0.05, threshold = 0.05;
+        try {
+            for (int i = 4; i < argc; ++i) {
+                string arg = argv[i];
+                if (arg == "--alpha" && i + 1 < argc) {
+                    alpha = stod(argv[++i]);
+                } else if (arg == "--threshold" && i + 1 < argc) {
+                    threshold = stod(argv[++i]);
+                } else {
+                    throw invalid_argument("Usage: " + string(argv[0]) +
+                                           " compare BASE.json NEW.json [--alpha A] [--threshold T]");
+                }
+            }
+            return compareBenchmarks(argv[2], argv[3], alpha, threshold);
+        } catch (const exception& e) {
+            cerr << e.what() << "\n";
+            return 1;
+        }
+    }
+
+    string jsonFile;
+    bool simulatorsOnly = false;
+    int samples = 10;
+    double minEngineRate = 10e6;
+    double maxStationBytes = 32;
+    for (int i = 1; i < argc; ++i) {
+        string arg = argv[i];
+        if (arg == "--json" && i + 1 < argc) {
+            jsonFile = argv[++i];
+        } else if (arg == "--simulators") {
+            simulatorsOnly = true;
+        } else if (arg == "--samples" && i + 1 < argc) {
+            samples = max(1, stoi(argv[++i]));
+        } else if (arg == "--min-engine-rate" && i + 1 < argc) {
+            minEngineRate = stod(argv[++i]) * 1e6;
+        } else if (arg == "--max-station-bytes" && i + 1 < argc) {
+            maxStationBytes = stod(argv[++i]);
+        } else {
+            cerr << "Usage: " << argv[0] << " [--json FILE] [--simulators] [--samples N] [--min-engine-rate M] [--max-station-bytes B]\n"
+                 << "       " << argv[0] << " compare BASE.json NEW.json [--alpha A] [--threshold T]\n"
+                 << "--json writes the access point benchmarks as JSON (- for stdout, alone); --simulators skips the\n"
+                 << "micro-benchmarks; each access point is timed over N runs (default 10). compare tests every cell\n"
+                 << "of two such files for a significant change and exits with 2 if one got slower. Exits with 3 if the\n"
+                 << "event engine runs below M million events/s at 100 WiFi 4 clients (default 10, 0 to skip) or a\n"
+                 << "WiFi 4 access point keeps more than B bytes per station at 1M clients (default 32, 0 to skip).\n";
+            return 1;
+        }
+    }
+    // First, so that the peak RSS of each cell is not inflated by the
+    // micro-benchmarks' buffers
+    vector<SimulatorBenchmark> simulators = benchmarkSimulators(samples);
+    const double engineRate = benchmarkEngineRate(samples);
+    if (!simulatorsOnly && jsonFile != "-") {
+        benchmarkEventQueues();
+        benchmarkRandomDraws();
+        benchmarkContentionSlots();
+        benchmarkTraceCodec();
+    }
+    // The JSON alone goes to stdout with --json -, so the verdict goes to stderr
+    ostream& report = jsonFile == "-" ? cerr : cout;
+    if (jsonFile == "-") {
+        writeSimulatorJson(cout, simulators);
+    } else {
+        printSimulatorSummary(cout, simulators);
+    }
+    report << "\nEngine throughput (WiFi 4, 100 clients, " << queueBackendName(QueueBackend::BinaryHeap) << "): "
+           << fixed << setprecision(2) << engineRate / 1e6 << " M events/s, target " << minEngineRate / 1e6 << "\n";
+    double stationBytes = 0;
+    if (maxStationBytes > 0) {
+        const int clients = 1000000;
+        double eventDriven = stationFootprint(clients, false), slotted = stationFootprint(clients, true);
+        stationBytes = max(eventDriven, slotted);
+        report << "WiFi 4 state per station at 1M clients: " << setprecision(1) << eventDriven
+               << " bytes event-driven, " << slotted << " slotted, limit " << maxStationBytes << "\n";
+    }
+    report.unsetf(ios::fixed);
+    if (!jsonFile.empty() && jsonFile != "-") {
+        ofstream out(jsonFile);
+        writeSimulatorJson(out, simulators);
+        if (!out) {
+            cerr << "Cannot write " << jsonFile << "\n";
+            return 1;
+        }
+        cout << "Wrote " << jsonFile << "\n";
+    }
+    if (engineRate < minEngineRate) {
+        cerr << "Engine throughput is below the target\n";
+        return 3;
+    }
+    if (stationBytes > maxStationBytes) {
+        cerr << "Per-station state is above the limit\n";
+        return 3;
+    }
+    return 0;
+}
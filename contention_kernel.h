@@ -0,0 +1,139 @@
+#ifndef CONTENTION_KERNEL_H
+#define CONTENTION_KERNEL_H
+
+#include <cstddef>
+#include <cstdint>
+
+#include "cpu_dispatch.h"
+
+// One idle contention slot over a station table's backoff counters. Every
+// running counter (non-zero) is decremented; a counter of 0 belongs to a
+// station with nothing to send and stays 0. The indices of the counters that
+// reach zero in this slot are written to expired[] in ascending order and
+// their number is returned: 1 is a successful transmission, more than 1 a
+// collision. expired[] must have room for n entries.
+//
+// The vector paths decrement 16 (AVX2) or 32 (AVX-512) counters per step
+// with a saturating subtract and only branch when a step has an expiry.
+
+// Counters [begin, end), branch-free
+inline size_t countdownRangeScalar(uint16_t* counters, size_t begin, size_t end, uint32_t* expired) {
+    size_t count = 0;
+    for (size_t i = begin; i < end; ++i) {
+        uint16_t c = counters[i];
+        expired[count] = static_cast<uint32_t>(i);
+        count += (c == 1);
+        counters[i] = static_cast<uint16_t>(c - (c != 0));
+    }
+    return count;
+}
+
+inline size_t countdownSlotScalar(uint16_t* counters, size_t n, uint32_t* expired) {
+    return countdownRangeScalar(counters, 0, n, expired);
+}
+
+#if WIFI_X86_SIMD
+__attribute__((target("avx2")))
+inline size_t countdownSlotAvx2(uint16_t* counters, size_t n, uint32_t* expired) {
+    const __m256i one = _mm256_set1_epi16(1);
+    size_t count = 0;
+    size_t i = 0;
+    for (; i + 16 <= n; i += 16) {
+        __m256i* p = reinterpret_cast<__m256i*>(counters + i);
+        __m256i c = _mm256_loadu_si256(p);
+        // movemask yields two adjacent bits per 16-bit lane
+        uint32_t hits = static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi16(c, one)));
+        _mm256_storeu_si256(p, _mm256_subs_epu16(c, one));
+        while (hits) {
+            expired[count++] = static_cast<uint32_t>(i + __builtin_ctz(hits) / 2);
+            hits &= hits - 1;
+            hits &= hits - 1;
+        }
+    }
+    return count + countdownRangeScalar(counters, i, n, expired + count);
+}
+
+__attribute__((target("avx512f,avx512bw")))
+inline size_t countdownSlotAvx512(uint16_t* counters, size_t n, uint32_t* expired) {
+    const __m512i one = _mm512_set1_epi16(1);
+    size_t count = 0;
+    size_t i = 0;
+    for (; i + 32 <= n; i += 32) {
+        __m512i c = _mm512_loadu_si512(counters + i);
+        uint32_t hits = _mm512_cmpeq_epi16_mask(c, one);
+        _mm512_storeu_si512(counters + i, _mm512_subs_epu16(c, one));
+        while (hits) {
+            expired[count++] = static_cast<uint32_t>(i + __builtin_ctz(hits));
+            hits &= hits - 1;
+        }
+    }
+    return count + countdownRangeScalar(counters, i, n, expired + count);
+}
+#endif
+
+inline size_t countdownSlot(uint16_t* counters, size_t n, uint32_t* expired) {
+#if WIFI_X86_SIMD
+    switch (activeSimdLevel()) {
+    case SimdLevel::AVX512: return countdownSlotAvx512(counters, n, expired);
+    case SimdLevel::AVX2: return countdownSlotAvx2(counters, n, expired);
+    default: break;
+    }
+#endif
+    return countdownSlotScalar(counters, n, expired);
+}
+
+// Lockstep replications: counters[s * lockstepLanes + r] is station s's
+// backoff counter in replication r, so one vector instruction advances the
+// same station in 16 independent scenarios. Counters are 0 for stations with
+// nothing to send.
+constexpr int lockstepLanes = 16;
+
+// One station's counters across the lanes. Only 2-byte aligned, so it can
+// view any uint16_t array.
+typedef uint16_t LaneCounters __attribute__((vector_size(2 * lockstepLanes), aligned(2)));
+
+// Skips each lane ahead to its next expiry: finds the lane's smallest running
+// counter, subtracts it from every running counter of the lane and stores it
+// in steps[lane] (0 for a lane with no running counter, which is left
+// untouched). The counters that reach zero are the lane's transmitters.
+// Written with GCC vector extensions; the wrappers below compile it for AVX2
+// or the baseline SSE2.
+__attribute__((always_inline))
+inline void skipToExpiryBody(uint16_t* counters, size_t n, uint16_t* steps) {
+    LaneCounters* station = reinterpret_cast<LaneCounters*>(counters);
+    const LaneCounters zero = {};
+    LaneCounters least = zero - 1;
+    for (size_t s = 0; s < n; ++s) {
+        LaneCounters c = station[s] - 1;   // an idle 0 wraps to the maximum
+        least = c < least ? c : least;
+    }
+    LaneCounters step = least + 1;
+    for (size_t s = 0; s < n; ++s) {
+        LaneCounters c = station[s];
+        station[s] = c - (step & reinterpret_cast<LaneCounters>(c != 0));
+    }
+    *reinterpret_cast<LaneCounters*>(steps) = step;
+}
+
+inline void skipToExpiryScalar(uint16_t* counters, size_t n, uint16_t* steps) {
+    skipToExpiryBody(counters, n, steps);
+}
+
+#if WIFI_X86_SIMD
+__attribute__((target("avx2")))
+inline void skipToExpiryAvx2(uint16_t* counters, size_t n, uint16_t* steps) {
+    skipToExpiryBody(counters, n, steps);
+}
+#endif
+
+inline void skipToExpiry(uint16_t* counters, size_t n, uint16_t* steps) {
+#if WIFI_X86_SIMD
+    if (activeSimdLevel() >= SimdLevel::AVX2) {
+        skipToExpiryAvx2(counters, n, steps);
+        return;
+    }
+#endif
+    skipToExpiryScalar(counters, n, steps);
+}
+
+#endif
@@ -0,0 +1,46 @@
+#ifndef CPU_DISPATCH_H
+#define CPU_DISPATCH_H
+
+// Runtime selection of the widest vector instruction set the CPU supports.
+// Kernels compile their AVX2 / AVX-512 variants with target attributes and
+// pick one per call through activeSimdLevel(), so a single binary runs on
+// any x86-64 machine and falls back to scalar code elsewhere.
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define WIFI_X86_SIMD 1
+#include <immintrin.h>
+#else
+#define WIFI_X86_SIMD 0
+#endif
+
+enum class SimdLevel { Scalar = 0, AVX2 = 1, AVX512 = 2 };
+
+inline const char* simdLevelName(SimdLevel level) {
+    switch (level) {
+    case SimdLevel::AVX512: return "avx512";
+    case SimdLevel::AVX2: return "avx2";
+    default: return "scalar";
+    }
+}
+
+inline SimdLevel detectSimdLevel() {
+#if WIFI_X86_SIMD
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512bw")) return SimdLevel::AVX512;
+    if (__builtin_cpu_supports("avx2")) return SimdLevel::AVX2;
+#endif
+    return SimdLevel::Scalar;
+}
+
+// Highest level kernels may use; lowered to benchmark or cross-check paths
+inline SimdLevel& simdLevelLimit() {
+    static SimdLevel limit = SimdLevel::AVX512;
+    return limit;
+}
+
+inline SimdLevel activeSimdLevel() {
+    static const SimdLevel detected = detectSimdLevel();
+    return detected < simdLevelLimit() ? detected : simdLevelLimit();
+}
+
+#endif
@@ -0,0 +1,129 @@
+#ifndef INSTRUMENTATION_H
+#define INSTRUMENTATION_H
+
+// Hot-path counters and per-phase timers for profiling the simulators.
+// Only builds with WIFI_INSTRUMENT=1 (make instrumented) keep them: the
+// hooks test a constexpr switch and the disabled phase timer is an empty
+// class, so a release build compiles every hook out. The timers also read
+// the hardware counters of perf_counters.h when those are on.
+
+#include <chrono>
+#include <cstdint>
+#include <iomanip>
+#include <ostream>
+#include <type_traits>
+
+#include "perf_counters.h"
+
+#ifndef WIFI_INSTRUMENT
+#define WIFI_INSTRUMENT 0
+#endif
+
+constexpr bool instrumentationEnabled = WIFI_INSTRUMENT != 0;
+
+enum class HotCounter { Attempts, Collisions, BackoffRedraws, ChannelFlips, Successes };
+constexpr int hotCounterCount = 5;
+
+inline const char* hotCounterName(HotCounter counter) {
+    static const char* const names[hotCounterCount] = {"attempts", "collisions", "backoff redraws",
+                                                       "channel flips", "successes"};
+    return names[static_cast<int>(counter)];
+}
+
+// What one thread counted since its last resetHotPathStats()
+struct HotPathStats {
+    uint64_t counts[hotCounterCount];
+    int64_t phaseNs[simPhaseCount];
+    uint64_t phaseCalls[simPhaseCount];
+};
+
+// Per thread, so sweep workers count their own runs
+inline HotPathStats& hotPathStats() {
+    thread_local HotPathStats stats = {};
+    return stats;
+}
+
+inline void resetHotPathStats() {
+    if constexpr (instrumentationEnabled) hotPathStats() = HotPathStats();
+}
+
+inline void countHotPath(HotCounter counter, uint64_t n = 1) {
+    if constexpr (instrumentationEnabled) hotPathStats().counts[static_cast<int>(counter)] += n;
+}
+
+// Adds the lifetime of the timer to its phase
+template <bool Enabled>
+class BasicPhaseTimer {
+private:
+    PerfScope counters;
+    SimPhase phase;
+    std::chrono::steady_clock::time_point start;
+
+public:
+    explicit BasicPhaseTimer(SimPhase phase)
+        : counters(phase), phase(phase), start(std::chrono::steady_clock::now()) {}
+
+    ~BasicPhaseTimer() {
+        HotPathStats& stats = hotPathStats();
+        stats.phaseNs[static_cast<int>(phase)] +=
+            std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+        stats.phaseCalls[static_cast<int>(phase)]++;
+    }
+
+    BasicPhaseTimer(const BasicPhaseTimer&) = delete;
+    BasicPhaseTimer& operator=(const BasicPhaseTimer&) = delete;
+};
+
+template <>
+class BasicPhaseTimer<false> {
+public:
+    explicit BasicPhaseTimer(SimPhase) {}
+};
+
+using PhaseTimer = BasicPhaseTimer<instrumentationEnabled>;
+
+// For the phases of a whole run, which are few enough to read the hardware
+// counters in release builds too
+using RunPhaseTimer = std::conditional_t<instrumentationEnabled, PhaseTimer, PerfScope>;
+
+// Counters and per-phase cost of the calling thread's last run, as a share
+// of setup + simulate + report; prints nothing in release builds. "other" is
+// the rest of simulate: the event queue and dispatch, or the slot clock.
+inline void printHotPathStats(std::ostream& out) {
+    if constexpr (instrumentationEnabled) {
+        const HotPathStats& stats = hotPathStats();
+        out << "Hot path:";
+        for (int c = 0; c < hotCounterCount; ++c) {
+            out << (c ? ", " : " ") << stats.counts[c] << " " << hotCounterName(static_cast<HotCounter>(c));
+        }
+        out << "\n";
+
+        auto ns = [&stats](SimPhase phase) { return stats.phaseNs[static_cast<int>(phase)]; };
+        double total = static_cast<double>(ns(SimPhase::Setup) + ns(SimPhase::Simulate) + ns(SimPhase::Report));
+        std::ios::fmtflags flags = out.flags();
+        std::streamsize precision = out.precision();
+        auto line = [&out, total](const char* indent, const char* name, int64_t phaseNs, uint64_t calls) {
+            out << indent << std::left << std::setw(12) << name << std::right << std::fixed << std::setprecision(3)
+                << std::setw(12) << phaseNs / 1e6 << " ms" << std::setprecision(1) << std::setw(7)
+                << (total > 0 ? 100.0 * phaseNs / total : 0) << "%";
+            if (calls > 0) out << std::setw(12) << calls << " calls" << std::setw(10) << phaseNs / double(calls) << " ns each";
+            out << "\n";
+        };
+        out << "Phases:\n";
+        const SimPhase order[] = {SimPhase::Setup, SimPhase::Simulate, SimPhase::Contention, SimPhase::Settle,
+                                  SimPhase::Arrivals, SimPhase::Report};
+        for (SimPhase phase : order) {
+            uint64_t calls = stats.phaseCalls[static_cast<int>(phase)];
+            bool inner = phase == SimPhase::Contention || phase == SimPhase::Settle || phase == SimPhase::Arrivals;
+            if (calls > 0) line(inner ? "    " : "  ", simPhaseName(phase), ns(phase), inner ? calls : 0);
+            if (phase == SimPhase::Arrivals && stats.phaseCalls[static_cast<int>(SimPhase::Simulate)] > 0) {
+                line("    ", "other", ns(SimPhase::Simulate) - ns(SimPhase::Contention) - ns(SimPhase::Settle) -
+                     ns(SimPhase::Arrivals), 0);
+            }
+        }
+        out.flags(flags);
+        out.precision(precision);
+    }
+}
+
+#endif
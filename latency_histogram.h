@@ -0,0 +1,109 @@
+#ifndef LATENCY_HISTOGRAM_H
+#define LATENCY_HISTOGRAM_H
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <vector>
+
+#include "sim_engine.h"
+
+// Log-linear (HDR-style) histogram of latencies in integer nanoseconds.
+// Values below 2^precisionBits are counted exactly; above that every power
+// of two is split into 2^(precisionBits-1) equal buckets, so a recorded
+// value is known to within a relative error of 2^-(precisionBits-1) and
+// memory is bounded by the bucket count, not the number of samples
+// (latencies are below 2^63, so at most (65 - precisionBits) *
+// 2^(precisionBits-1) counters; 7,296 for the default 8 bits).
+// Count, sum, min and max are kept exactly.
+class LatencyHistogram {
+private:
+    int precisionBits;
+    std::vector<uint64_t> counts;   // grown on demand up to the highest bucket used
+    uint64_t total;
+    int64_t sum;
+    SimTime minValue;
+    SimTime maxValue;
+
+    size_t bucketOf(uint64_t v) const {
+        if (v < (1ULL << precisionBits)) return static_cast<size_t>(v);
+        int shift = 63 - __builtin_clzll(v) - precisionBits + 1;
+        return (static_cast<size_t>(shift) << (precisionBits - 1)) + static_cast<size_t>(v >> shift);
+    }
+
+    // Smallest value that falls into bucket i, and the bucket's width
+    uint64_t bucketStart(size_t i, uint64_t& width) const {
+        const size_t half = size_t(1) << (precisionBits - 1);
+        if (i < 2 * half) {
+            width = 1;
+            return i;
+        }
+        int shift = static_cast<int>(i / half) - 1;
+        width = 1ULL << shift;
+        return static_cast<uint64_t>(i % half + half) << shift;
+    }
+
+public:
+    // precisionBits from 2 to 16; 8 keeps every value within 0.8%
+    explicit LatencyHistogram(int precisionBits = 8) : precisionBits(std::min(std::max(precisionBits, 2), 16)) {
+        clear();
+    }
+
+    void setPrecision(int bits) {
+        precisionBits = std::min(std::max(bits, 2), 16);
+        counts.clear();
+        clear();
+    }
+    int getPrecision() const { return precisionBits; }
+
+    // Keeps the allocated buckets for reuse
+    void clear() {
+        std::fill(counts.begin(), counts.end(), 0);
+        total = 0;
+        sum = 0;
+        minValue = std::numeric_limits<SimTime>::max();
+        maxValue = 0;
+    }
+
+    void record(SimTime latency) {
+        uint64_t v = static_cast<uint64_t>(std::max<SimTime>(latency, 0));
+        size_t i = bucketOf(v);
+        if (i >= counts.size()) counts.resize(i + 1, 0);
+        counts[i]++;
+        total++;
+        sum += static_cast<int64_t>(v);
+        minValue = std::min(minValue, static_cast<SimTime>(v));
+        maxValue = std::max(maxValue, static_cast<SimTime>(v));
+    }
+
+    uint64_t count() const { return total; }
+    int64_t totalNanoseconds() const { return sum; }
+    SimTime min() const { return total ? minValue : 0; }
+    SimTime max() const { return maxValue; }
+    double mean() const { return total ? static_cast<double>(sum) / total : 0; }
+
+    // Nearest-rank percentile (p in [0, 100]), reported as the middle of
+    // the bucket that holds it, clamped to the exact min and max
+    SimTime percentile(double p) const {
+        if (total == 0) return 0;
+        uint64_t rank = static_cast<uint64_t>(std::ceil(p / 100.0 * total));
+        rank = std::min(std::max<uint64_t>(rank, 1), total);
+        uint64_t seen = 0;
+        for (size_t i = 0; i < counts.size(); ++i) {
+            seen += counts[i];
+            if (seen >= rank) {
+                uint64_t width;
+                uint64_t start = bucketStart(i, width);
+                SimTime mid = static_cast<SimTime>(start + (width - 1) / 2);
+                return std::min(std::max(mid, minValue), maxValue);
+            }
+        }
+        return maxValue;
+    }
+
+    size_t memoryBytes() const { return counts.capacity() * sizeof(uint64_t); }
+};
+
+#endif
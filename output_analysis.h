@@ -0,0 +1,466 @@
+#ifndef OUTPUT_ANALYSIS_H
+#define OUTPUT_ANALYSIS_H
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+// Online output analysis: Welford mean/variance, batch-means confidence
+// intervals for correlated observations, MSER-5 warm-up truncation and a
+// sequential stopping rule.
+
+// Running mean and variance (Welford). merge() uses Chan et al.'s pairwise
+// update, so per-worker statistics can be combined.
+class RunningStats {
+private:
+    uint64_t n;
+    double m;
+    double m2;
+
+public:
+    RunningStats() : n(0), m(0), m2(0) {}
+
+    void clear() { *this = RunningStats(); }
+
+    void add(double x) {
+        n++;
+        double delta = x - m;
+        m += delta / n;
+        m2 += delta * (x - m);
+    }
+
+    void merge(const RunningStats& other) {
+        if (other.n == 0) return;
+        if (n == 0) {
+            *this = other;
+            return;
+        }
+        uint64_t total = n + other.n;
+        double delta = other.m - m;
+        m += delta * other.n / total;
+        m2 += other.m2 + delta * delta * (static_cast<double>(n) * other.n / total);
+        n = total;
+    }
+
+    uint64_t count() const { return n; }
+    double mean() const { return m; }
+    double variance() const { return n > 1 ? m2 / (n - 1) : 0; }
+    double stddev() const { return std::sqrt(variance()); }
+};
+
+// Standard normal quantile (Acklam's rational approximation, |error| < 1.2e-9)
+inline double normalQuantile(double p) {
+    static const double a[] = {-3.969683028665376e+01, 2.209460984245205e+02, -2.759285104469687e+02,
+                               1.383577518672690e+02, -3.066479806614716e+01, 2.506628277459239e+00};
+    static const double b[] = {-5.447609879822406e+01, 1.615858368580409e+02, -1.556989798598866e+02,
+                               6.680131188771972e+01, -1.328068155288572e+01};
+    static const double c[] = {-7.784894002430293e-03, -3.223964580411365e-01, -2.400758277161838e+00,
+                               -2.549732539343734e+00, 4.374664141464968e+00, 2.938163982698783e+00};
+    static const double d[] = {7.784695709041462e-03, 3.224671290700398e-01, 2.445134137142996e+00,
+                               3.754408661907416e+00};
+    if (p <= 0) return -INFINITY;
+    if (p >= 1) return INFINITY;
+    if (p < 0.02425) {
+        double q = std::sqrt(-2 * std::log(p));
+        return (((((c[0] * q + c[1]) * q + c[2]) * q + c[3]) * q + c[4]) * q + c[5]) /
+               ((((d[0] * q + d[1]) * q + d[2]) * q + d[3]) * q + 1);
+    }
+    if (p > 1 - 0.02425) return -normalQuantile(1 - p);
+    double q = p - 0.5;
+    double r = q * q;
+    return (((((a[0] * r + a[1]) * r + a[2]) * r + a[3]) * r + a[4]) * r + a[5]) * q /
+           (((((b[0] * r + b[1]) * r + b[2]) * r + b[3]) * r + b[4]) * r + 1);
+}
+
+// Regularized incomplete beta function I_x(a, b), from its continued
+// fraction (Lentz's method, as in Numerical Recipes 6.4)
+inline double incompleteBeta(double a, double b, double x) {
+    if (x <= 0) return 0;
+    if (x >= 1) return 1;
+    // The fraction converges quickly below the mean; above it, use symmetry
+    if (x > (a + 1) / (a + b + 2)) return 1 - incompleteBeta(b, a, 1 - x);
+    const double tiny = 1e-300;
+    double front = std::exp(std::lgamma(a + b) - std::lgamma(a) - std::lgamma(b) + a * std::log(x) +
+                            b * std::log1p(-x)) / a;
+    double c = 1, d = 1 - (a + b) * x / (a + 1);
+    d = 1 / (std::fabs(d) < tiny ? tiny : d);
+    double f = d;
+    for (int m = 1; m <= 300; ++m) {
+        for (int odd = 0; odd < 2; ++odd) {
+            double numerator = odd ? -(a + m) * (a + b + m) * x / ((a + 2 * m) * (a + 2 * m + 1))
+                                   : m * (b - m) * x / ((a + 2 * m - 1) * (a + 2 * m));
+            d = 1 + numerator * d;
+            d = 1 / (std::fabs(d) < tiny ? tiny : d);
+            c = 1 + numerator / c;
+            if (std::fabs(c) < tiny) c = tiny;
+            f *= c * d;
+        }
+        if (std::fabs(c * d - 1) < 1e-15) break;
+    }
+    return front * f;
+}
+
+// Two-sided Student t critical value for `confidence` (e.g. 0.95) and df
+// degrees of freedom. Above 30 df the Cornish-Fisher expansion around the
+// normal quantile is within 1e-4 of the exact value; at fewer it is far off
+// (9.7 instead of 12.706 at 1 df), so there it only starts a safeguarded
+// Newton iteration on the exact two-sided tail, I_x(df/2, 1/2) with
+// x = df / (df + t^2).
+inline double studentTCritical(double confidence, uint64_t df) {
+    if (df == 0) return INFINITY;
+    double z = normalQuantile(0.5 + confidence / 2);
+    double v = static_cast<double>(df);
+    double z3 = z * z * z, z5 = z3 * z * z, z7 = z5 * z * z;
+    double t = z + (z3 + z) / (4 * v) + (5 * z5 + 16 * z3 + 3 * z) / (96 * v * v) +
+               (3 * z7 + 19 * z5 + 17 * z3 - 15 * z) / (384 * v * v * v);
+    if (df > 30) return t;
+
+    const double alpha = 1 - confidence;
+    // log of Gamma((v+1)/2) / (sqrt(v pi) Gamma(v/2)); Gamma(1/2) = sqrt(pi)
+    const double logDensityScale =
+        std::lgamma((v + 1) / 2) - std::lgamma(v / 2) - std::lgamma(0.5) - 0.5 * std::log(v);
+    double low = 0, high = INFINITY;   // brackets the root
+    for (int i = 0; i < 100; ++i) {
+        double excess = incompleteBeta(v / 2, 0.5, v / (v + t * t)) - alpha;
+        if (excess > 0) {
+            low = t;
+        } else {
+            high = t;
+        }
+        // The tail falls by twice the density as t grows
+        double density = std::exp(logDensityScale - (v + 1) / 2 * std::log1p(t * t / v));
+        double next = t + excess / (2 * density);
+        if (!(next > low && next < high)) next = high < INFINITY ? (low + high) / 2 : 2 * std::max(t, 1.0);
+        if (std::fabs(next - t) <= 1e-12 * t) return next;
+        t = next;
+    }
+    return t;
+}
+
+// Two-sided Mann-Whitney U test: how likely two samples at least this far
+// apart in rank are if both come from one distribution, whatever its shape.
+// Exact for samples of up to 20 without ties, otherwise the normal
+// approximation with tie and continuity corrections.
+struct RankSumTest {
+    double u;        // pairs (x from a, y from b) with x > y; ties count 1/2
+    double pValue;
+};
+
+inline RankSumTest mannWhitneyU(const std::vector<double>& a, const std::vector<double>& b) {
+    const size_t m = a.size(), n = b.size();
+    RankSumTest result{0, 1};
+    if (m == 0 || n == 0) return result;
+    std::vector<std::pair<double, bool>> pooled;   // (value, from a)
+    for (double x : a) pooled.emplace_back(x, true);
+    for (double y : b) pooled.emplace_back(y, false);
+    std::sort(pooled.begin(), pooled.end());
+    // Midranks: a run of t tied values shares the mean of its ranks
+    double rankSumA = 0;
+    double tieTerm = 0;   // sum of t^3 - t over the runs
+    for (size_t i = 0; i < pooled.size();) {
+        size_t j = i;
+        while (j < pooled.size() && pooled[j].first == pooled[i].first) ++j;
+        double t = static_cast<double>(j - i);
+        double midrank = (i + 1 + j) / 2.0;
+        for (size_t k = i; k < j; ++k) {
+            if (pooled[k].second) rankSumA += midrank;
+        }
+        tieTerm += t * t * t - t;
+        i = j;
+    }
+    result.u = rankSumA - m * (m + 1) / 2.0;
+
+    if (tieTerm == 0 && m <= 20 && n <= 20) {
+        // w[u]: orderings of the m + n values with U = u. These are the
+        // coefficients of the Gaussian binomial [m+n choose m](q), built in
+        // place as the product over i <= m of (1 - q^(n+i)) / (1 - q^i);
+        // every partial product is a polynomial, so each division is exact.
+        std::vector<double> w(m * n + 1, 0);
+        w[0] = 1;
+        for (size_t i = 1; i <= m; ++i) {
+            for (size_t u = w.size(); u-- > n + i;) w[u] -= w[u - n - i];
+            for (size_t u = i; u < w.size(); ++u) w[u] += w[u - i];
+        }
+        double total = 0, below = 0, above = 0;
+        size_t u = static_cast<size_t>(result.u);
+        for (size_t k = 0; k < w.size(); ++k) {
+            total += w[k];
+            if (k <= u) below += w[k];
+            if (k >= u) above += w[k];
+        }
+        result.pValue = std::min(1.0, 2 * std::min(below, above) / total);
+        return result;
+    }
+
+    const double total = static_cast<double>(m + n);
+    double variance = m * n / 12.0 * ((total + 1) - tieTerm / (total * (total - 1)));
+    if (variance <= 0) return result;   // every value tied
+    double z = std::max(0.0, std::fabs(result.u - m * n / 2.0) - 0.5) / std::sqrt(variance);
+    result.pValue = std::min(1.0, std::erfc(z / std::sqrt(2.0)));
+    return result;
+}
+
+// Batch means for a correlated output series. Observations are averaged in
+// batches; once maxBatches are full, neighbouring batches are merged and the
+// batch size doubles, so memory stays bounded and batches keep growing
+// until they are long enough to be nearly independent.
+class BatchMeans {
+private:
+    size_t batchSize;
+    size_t maxBatches;
+    std::vector<double> batches;   // completed batch means
+    double partialSum;
+    size_t partialCount;
+    double totalSum;
+    uint64_t total;
+
+public:
+    explicit BatchMeans(size_t initialBatchSize = 16, size_t maxBatches = 64)
+        : batchSize(initialBatchSize), maxBatches(maxBatches & ~size_t(1)) {
+        clear(initialBatchSize);
+    }
+
+    void clear(size_t initialBatchSize) {
+        batchSize = initialBatchSize;
+        batches.clear();
+        partialSum = 0;
+        partialCount = 0;
+        totalSum = 0;
+        total = 0;
+    }
+
+    // Returns true when the observation completed a batch
+    bool add(double x) {
+        partialSum += x;
+        totalSum += x;
+        total++;
+        if (++partialCount < batchSize) return false;
+        batches.push_back(partialSum / batchSize);
+        partialSum = 0;
+        partialCount = 0;
+        if (batches.size() == maxBatches) {
+            for (size_t i = 0; i < maxBatches / 2; ++i) {
+                batches[i] = (batches[2 * i] + batches[2 * i + 1]) / 2;
+            }
+            batches.resize(maxBatches / 2);
+            batchSize *= 2;
+        }
+        return true;
+    }
+
+    // Puts `count` observations, value(0) .. value(count - 1), in front of
+    // the series as if they had been added first. They are batched back from
+    // the end at the current batch size, so the batch next to the existing
+    // ones is full; the few left over at the front count towards the mean
+    // only, like an incomplete last batch.
+    template <class Value>
+    void prepend(size_t count, Value value) {
+        const size_t full = count / batchSize;
+        const size_t skipped = count - full * batchSize;
+        for (size_t i = 0; i < skipped; ++i) totalSum += value(i);
+        batches.insert(batches.begin(), full, 0.0);
+        for (size_t b = 0; b < full; ++b) {
+            double sum = 0;
+            for (size_t i = skipped + b * batchSize; i < skipped + (b + 1) * batchSize; ++i) sum += value(i);
+            totalSum += sum;
+            batches[b] = sum / batchSize;
+        }
+        total += count;
+        // Pair from the end; an odd first batch is left to the mean, as above
+        while (batches.size() >= maxBatches) {
+            const size_t odd = batches.size() % 2;
+            for (size_t i = 0; i < batches.size() / 2; ++i) {
+                batches[i] = (batches[odd + 2 * i] + batches[odd + 2 * i + 1]) / 2;
+            }
+            batches.resize(batches.size() / 2);
+            batchSize *= 2;
+        }
+    }
+
+    uint64_t count() const { return total; }
+    size_t batchCount() const { return batches.size(); }
+    double mean() const { return total ? totalSum / total : 0; }
+
+    // Half-width of the confidence interval for the mean; infinite with
+    // fewer than two batches
+    double halfWidth(double confidence) const {
+        if (batches.size() < 2) return INFINITY;
+        RunningStats stats;
+        for (double b : batches) stats.add(b);
+        return studentTCritical(confidence, batches.size() - 1) * stats.stddev() / std::sqrt(batches.size());
+    }
+
+    double relativeHalfWidth(double confidence) const {
+        double m = mean();
+        return m != 0 ? halfWidth(confidence) / std::fabs(m) : INFINITY;
+    }
+};
+
+// MSER-5 warm-up detection (White, 1997). Observations are averaged in
+// batches of 5; truncating the first d batches leaves k - d batch means
+// Z[d..k), and the truncation point is the d <= k/2 that minimizes
+//   MSER(d) = sum (Z[j] - mean(Z[d..k)))^2 / (k - d)^2,
+// which trades the bias of the transient against the variance lost with the
+// dropped data. Only the first `capacity` observations can be dropped: they
+// are held back until truncate() runs, while later ones are only folded into
+// the statistics of their batch means, so memory is bounded by the capacity.
+class WarmupTruncation {
+private:
+    size_t capacity;
+    std::vector<double> heldValues;   // the first observations, held back
+    std::vector<double> heldTimes;
+    RunningStats tailBatches;         // batch means past the held observations
+    double partialSum;
+    size_t partialCount;
+    size_t discardedCount;
+    double warmupEndTime;
+
+public:
+    static constexpr size_t batchSize = 5;
+
+    explicit WarmupTruncation(size_t capacity = 8192) : capacity(capacity - capacity % batchSize) { clear(); }
+
+    // 0 turns truncation off: nothing is held back or dropped
+    void setCapacity(size_t observations) { capacity = observations - observations % batchSize; }
+
+    // Keeps the allocated buffers for reuse
+    void clear() {
+        heldValues.clear();
+        heldTimes.clear();
+        tailBatches.clear();
+        partialSum = 0;
+        partialCount = 0;
+        discardedCount = 0;
+        warmupEndTime = 0;
+    }
+
+    // One observation at time `at`. Returns true if it is held back, in which
+    // case the caller records it after truncate() unless it was dropped.
+    bool hold(double value, double at) {
+        if (heldValues.size() < capacity) {
+            heldValues.push_back(value);
+            heldTimes.push_back(at);
+            return true;
+        }
+        partialSum += value;
+        if (++partialCount == batchSize) {
+            tailBatches.add(partialSum / batchSize);
+            partialSum = 0;
+            partialCount = 0;
+        }
+        return false;
+    }
+
+    // Picks the truncation point at the end of a run and returns the number
+    // of dropped observations; held ones from that index on are kept
+    size_t truncate() {
+        const size_t heldBatches = heldValues.size() / batchSize;
+        const uint64_t k = heldBatches + tailBatches.count();
+        const size_t limit = std::min<uint64_t>(heldBatches, k / 2);
+        RunningStats suffix = tailBatches;
+        double best = INFINITY;
+        size_t bestBatch = 0;
+        // Grow the suffix Z[d..k) one batch at a time, from d = heldBatches down
+        for (size_t d = heldBatches + 1; d-- > 0;) {
+            if (d < heldBatches) {
+                double sum = 0;
+                for (size_t i = d * batchSize; i < (d + 1) * batchSize; ++i) sum += heldValues[i];
+                suffix.add(sum / batchSize);
+            }
+            if (d > limit || suffix.count() < 2) continue;
+            double remaining = static_cast<double>(suffix.count());
+            double mser = suffix.variance() * (remaining - 1) / (remaining * remaining);
+            if (mser <= best) {   // ties go to the shorter warm-up
+                best = mser;
+                bestBatch = d;
+            }
+        }
+        discardedCount = bestBatch * batchSize;
+        warmupEndTime = discardedCount ? heldTimes[discardedCount - 1] : 0;
+        return discardedCount;
+    }
+
+    size_t heldCount() const { return heldValues.size(); }
+    double heldValue(size_t i) const { return heldValues[i]; }
+    double heldTime(size_t i) const { return heldTimes[i]; }
+
+    // Result of the last truncate()
+    size_t discarded() const { return discardedCount; }
+    double warmupEnd() const { return warmupEndTime; }   // time of the last dropped observation
+};
+
+// Target precision for sequential stopping; a target of 0 disables it
+struct StoppingRule {
+    double relativeHalfWidth = 0;   // e.g. 0.01 for +-1%
+    double confidence = 0.95;
+    size_t minBatches = 20;         // batches required before testing
+};
+
+// Batch-means CIs for the latency and throughput of one run. Throughput is
+// tracked through the time between deliveries: its mean is bits per
+// delivery over throughput, so both have the same relative half-width to
+// first order. With an active rule, converged() turns true once both
+// intervals are within the target.
+class SequentialEstimator {
+private:
+    StoppingRule rule;
+    BatchMeans latency;
+    BatchMeans interval;
+    double lastDelivery;
+    bool done;
+
+    bool precise(const BatchMeans& series) const {
+        return series.batchCount() >= rule.minBatches &&
+               series.relativeHalfWidth(rule.confidence) <= rule.relativeHalfWidth;
+    }
+
+public:
+    SequentialEstimator() : lastDelivery(0), done(false) {}
+
+    void setRule(const StoppingRule& newRule) { rule = newRule; }
+    const StoppingRule& getRule() const { return rule; }
+    bool active() const { return rule.relativeHalfWidth > 0; }
+
+    void clear() {
+        latency.clear(16);
+        interval.clear(16);
+        lastDelivery = 0;
+        done = false;
+    }
+
+    // One delivered packet: its latency and delivery time (any unit).
+    // Returns converged().
+    bool observe(double latencyValue, double deliveredAt) {
+        bool completed = latency.add(latencyValue);
+        completed = interval.add(deliveredAt - lastDelivery) || completed;
+        lastDelivery = deliveredAt;
+        if (completed && active() && !done) {
+            done = precise(latency) && precise(interval);
+        }
+        return done;
+    }
+
+    // A delivery that is held back for warm-up detection: only its time is
+    // kept, so the next interval is measured from it
+    void skip(double deliveredAt) { lastDelivery = deliveredAt; }
+
+    // Adds `count` deliveries that preceded the observed ones, by their
+    // latency(i) and interval(i) since the delivery before. Used for the
+    // held-back deliveries kept once the warm-up is truncated.
+    template <class Latency, class Interval>
+    void prepend(size_t count, Latency latencyAt, Interval intervalAt) {
+        latency.prepend(count, latencyAt);
+        interval.prepend(count, intervalAt);
+        if (active() && !done) done = precise(latency) && precise(interval);
+    }
+
+    bool converged() const { return done; }
+
+    const BatchMeans& latencySeries() const { return latency; }
+    const BatchMeans& intervalSeries() const { return interval; }
+};
+
+#endif
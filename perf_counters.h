@@ -0,0 +1,270 @@
+#ifndef PERF_COUNTERS_H
+#define PERF_COUNTERS_H
+
+// Hardware performance counters (Linux perf_event_open) per simulation
+// phase, for --perf-counters. Each thread opens one counter group on
+// itself, user space only, and a PerfScope adds the group's deltas over
+// its lifetime to its phase. Counters the CPU or the kernel do not offer
+// (virtual machines often have none) are left out and reported as such.
+
+#include <atomic>
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <iomanip>
+#include <ostream>
+#include <string>
+
+#if defined(__linux__)
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#define WIFI_PERF_EVENTS 1
+#else
+#define WIFI_PERF_EVENTS 0
+#endif
+
+// Setup, Simulate and Report follow each other in a run; Contention,
+// Settle and Arrivals are nested in Simulate
+enum class SimPhase { Setup, Simulate, Contention, Settle, Arrivals, Report };
+constexpr int simPhaseCount = 6;
+
+inline const char* simPhaseName(SimPhase phase) {
+    static const char* const names[simPhaseCount] = {"setup", "simulate", "contention", "settle", "arrivals",
+                                                     "report"};
+    return names[static_cast<int>(phase)];
+}
+
+enum class PerfCounter { Cycles, Instructions, L1DMisses, LLCMisses, BranchMisses };
+constexpr int perfCounterCount = 5;
+
+inline const char* perfCounterName(PerfCounter counter) {
+    static const char* const names[perfCounterCount] = {"cycles", "instructions", "L1D misses", "LLC misses",
+                                                        "branch misses"};
+    return names[static_cast<int>(counter)];
+}
+
+// Set once by main before any run
+inline std::atomic<bool>& perfCountersRequested() {
+    static std::atomic<bool> requested(false);
+    return requested;
+}
+
+// Counts per phase since the last reset; a counter the group could not
+// open stays at zero and is flagged in `available`
+struct PerfPhaseCounts {
+    uint64_t values[simPhaseCount][perfCounterCount];
+    uint64_t scopes[simPhaseCount];
+};
+
+// Raw counter totals with the group's enabled and running times, which
+// tell how much of the time the kernel had it on the PMU
+struct PerfReading {
+    uint64_t values[perfCounterCount];
+    uint64_t enabledNs;
+    uint64_t runningNs;
+};
+
+// The calling thread's counter group
+class PerfCounterGroup {
+private:
+    int leader;
+    int fds[perfCounterCount];
+    int slot[perfCounterCount];   // position in a group read, -1 if not open
+    int opened;
+    std::string error;            // why the group is empty, if it is
+
+#if WIFI_PERF_EVENTS
+    static perf_event_attr attributes(PerfCounter counter) {
+        perf_event_attr attr;
+        std::memset(&attr, 0, sizeof(attr));
+        attr.size = sizeof(attr);
+        attr.exclude_kernel = 1;
+        attr.exclude_hv = 1;
+        attr.read_format = PERF_FORMAT_GROUP | PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+        const uint64_t readMiss = (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+        switch (counter) {
+        case PerfCounter::Cycles:
+            attr.type = PERF_TYPE_HARDWARE;
+            attr.config = PERF_COUNT_HW_CPU_CYCLES;
+            break;
+        case PerfCounter::Instructions:
+            attr.type = PERF_TYPE_HARDWARE;
+            attr.config = PERF_COUNT_HW_INSTRUCTIONS;
+            break;
+        case PerfCounter::L1DMisses:
+            attr.type = PERF_TYPE_HW_CACHE;
+            attr.config = PERF_COUNT_HW_CACHE_L1D | readMiss;
+            break;
+        case PerfCounter::LLCMisses:
+            attr.type = PERF_TYPE_HW_CACHE;
+            attr.config = PERF_COUNT_HW_CACHE_LL | readMiss;
+            break;
+        case PerfCounter::BranchMisses:
+            attr.type = PERF_TYPE_HARDWARE;
+            attr.config = PERF_COUNT_HW_BRANCH_MISSES;
+            break;
+        }
+        return attr;
+    }
+#endif
+
+public:
+    PerfCounterGroup() : leader(-1), opened(0) {
+        for (int c = 0; c < perfCounterCount; ++c) {
+            fds[c] = -1;
+            slot[c] = -1;
+        }
+#if WIFI_PERF_EVENTS
+        for (int c = 0; c < perfCounterCount; ++c) {
+            perf_event_attr attr = attributes(static_cast<PerfCounter>(c));
+            attr.disabled = leader < 0;   // the leader starts the whole group
+            long fd = ::syscall(SYS_perf_event_open, &attr, 0, -1, leader, 0);
+            if (fd < 0) {
+                if (error.empty()) error = std::string(perfCounterName(static_cast<PerfCounter>(c))) + ": " + std::strerror(errno);
+                continue;
+            }
+            fds[c] = static_cast<int>(fd);
+            slot[c] = opened++;
+            if (leader < 0) leader = fds[c];
+        }
+        if (leader >= 0) ::ioctl(leader, PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+#else
+        error = "perf_event_open needs Linux";
+#endif
+    }
+
+    ~PerfCounterGroup() {
+#if WIFI_PERF_EVENTS
+        for (int fd : fds) {
+            if (fd >= 0) ::close(fd);
+        }
+#endif
+    }
+
+    PerfCounterGroup(const PerfCounterGroup&) = delete;
+    PerfCounterGroup& operator=(const PerfCounterGroup&) = delete;
+
+    bool active() const { return leader >= 0; }
+    bool available(PerfCounter counter) const { return slot[static_cast<int>(counter)] >= 0; }
+    const std::string& getError() const { return error; }
+
+    // Current raw totals and how long the group was enabled and actually
+    // counting; false if the group could not be read
+    bool read(PerfReading& reading) const {
+        reading = PerfReading();
+#if WIFI_PERF_EVENTS
+        uint64_t buffer[3 + perfCounterCount];   // count, time enabled, time running, values
+        if (leader < 0 || ::read(leader, buffer, sizeof(buffer)) < static_cast<ssize_t>(3 * sizeof(uint64_t))) {
+            return false;
+        }
+        reading.enabledNs = buffer[1];
+        reading.runningNs = buffer[2];
+        for (int c = 0; c < perfCounterCount; ++c) {
+            if (slot[c] >= 0) reading.values[c] = buffer[3 + slot[c]];
+        }
+        return true;
+#else
+        return false;
+#endif
+    }
+};
+
+// This thread's group, opened on first use once counters are requested;
+// nullptr while they are not
+inline PerfCounterGroup* threadPerfCounters() {
+    thread_local PerfCounterGroup* group = nullptr;
+    thread_local bool tried = false;
+    if (!tried && perfCountersRequested().load(std::memory_order_relaxed)) {
+        tried = true;
+        thread_local PerfCounterGroup opened;
+        group = &opened;
+    }
+    return group;
+}
+
+inline PerfPhaseCounts& perfPhaseCounts() {
+    thread_local PerfPhaseCounts counts = {};
+    return counts;
+}
+
+inline void resetPerfPhaseCounts() { perfPhaseCounts() = PerfPhaseCounts(); }
+
+// Adds the counts over its lifetime to `phase`; costs one read() at each
+// end when counters are on, and a thread-local load when they are off.
+// The raw counts and times are subtracted first and only the differences
+// scaled for multiplexing, so a delta never goes negative.
+class PerfScope {
+private:
+    PerfCounterGroup* group;
+    SimPhase phase;
+    PerfReading start;
+    bool started;
+
+public:
+    explicit PerfScope(SimPhase phase) : group(threadPerfCounters()), phase(phase), start(), started(false) {
+        if (group && group->active()) started = group->read(start);
+    }
+
+    ~PerfScope() {
+        PerfReading end;
+        if (!started || !group->read(end)) return;
+        const uint64_t enabled = end.enabledNs - start.enabledNs;
+        const uint64_t running = end.runningNs - start.runningNs;
+        const double scale = running > 0 && running < enabled ? static_cast<double>(enabled) / running : 1.0;
+        PerfPhaseCounts& counts = perfPhaseCounts();
+        for (int c = 0; c < perfCounterCount; ++c) {
+            uint64_t delta = end.values[c] >= start.values[c] ? end.values[c] - start.values[c] : 0;
+            counts.values[static_cast<int>(phase)][c] += static_cast<uint64_t>(delta * scale);
+        }
+        counts.scopes[static_cast<int>(phase)]++;
+    }
+
+    PerfScope(const PerfScope&) = delete;
+    PerfScope& operator=(const PerfScope&) = delete;
+};
+
+// Counts of the calling thread's last run per simulated packet, one line
+// per phase that was measured; nothing unless counters were requested
+inline void printPerfCounters(std::ostream& out, uint64_t packets) {
+    PerfCounterGroup* group = threadPerfCounters();
+    if (!group) return;
+    if (!group->active()) {
+        out << "Hardware counters unavailable (" << group->getError() << ")\n";
+        return;
+    }
+    const PerfPhaseCounts& counts = perfPhaseCounts();
+    std::ios::fmtflags flags = out.flags();
+    std::streamsize precision = out.precision();
+    out << "Hardware counters per packet (" << packets << " packets):\n" << std::left << std::setw(16) << "  phase"
+        << std::right;
+    for (int c = 0; c < perfCounterCount; ++c) out << std::setw(15) << perfCounterName(static_cast<PerfCounter>(c));
+    out << std::setw(8) << "IPC" << "\n" << std::fixed;
+    const SimPhase order[] = {SimPhase::Setup, SimPhase::Simulate, SimPhase::Contention, SimPhase::Settle,
+                              SimPhase::Arrivals, SimPhase::Report};
+    for (SimPhase phase : order) {
+        const int p = static_cast<int>(phase);
+        if (counts.scopes[p] == 0) continue;
+        bool inner = phase == SimPhase::Contention || phase == SimPhase::Settle || phase == SimPhase::Arrivals;
+        out << (inner ? "    " : "  ") << std::left << std::setw(inner ? 12 : 14) << simPhaseName(phase) << std::right;
+        for (int c = 0; c < perfCounterCount; ++c) {
+            if (!group->available(static_cast<PerfCounter>(c))) {
+                out << std::setw(15) << "n/a";
+            } else {
+                out << std::setprecision(2) << std::setw(15)
+                    << static_cast<double>(counts.values[p][c]) / (packets > 0 ? packets : 1);
+            }
+        }
+        uint64_t cycles = counts.values[p][static_cast<int>(PerfCounter::Cycles)];
+        if (group->available(PerfCounter::Cycles) && group->available(PerfCounter::Instructions) && cycles > 0) {
+            out << std::setprecision(2) << std::setw(8)
+                << static_cast<double>(counts.values[p][static_cast<int>(PerfCounter::Instructions)]) / cycles;
+        }
+        out << "\n";
+    }
+    out.flags(flags);
+    out.precision(precision);
+}
+
+#endif
@@ -0,0 +1,131 @@
+#ifndef QUANTILE_SKETCH_H
+#define QUANTILE_SKETCH_H
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <stdexcept>
+#include <vector>
+
+#include "sim_engine.h"
+
+// DDSketch (Masson et al., VLDB'19) of latencies in integer nanoseconds.
+// A value v > 0 is counted in bin ceil(log_gamma(v)) with
+// gamma = (1 + a) / (1 - a), so every quantile is reported within relative
+// accuracy a. Sketches with the same accuracy merge by adding bin counts;
+// count, sum, min and max are integers, so merging is exact, associative
+// and commutative, and a merged report does not depend on the order in
+// which workers finished.
+class QuantileSketch {
+private:
+    double relativeAccuracy;
+    double gamma;
+    double logGamma;
+    int32_t firstBin;               // index of bins[0]
+    std::vector<uint64_t> bins;
+    uint64_t zeroCount;             // latencies of 0 ns
+    uint64_t total;
+    int64_t sum;
+    SimTime minValue;
+    SimTime maxValue;
+
+    int32_t binOf(SimTime v) const { return static_cast<int32_t>(std::ceil(std::log(static_cast<double>(v)) / logGamma)); }
+
+    void addToBin(int32_t bin, uint64_t n) {
+        if (bins.empty()) {
+            firstBin = bin;
+            bins.assign(1, 0);
+        } else if (bin < firstBin) {
+            bins.insert(bins.begin(), static_cast<size_t>(firstBin - bin), 0);
+            firstBin = bin;
+        } else if (bin >= firstBin + static_cast<int32_t>(bins.size())) {
+            bins.resize(static_cast<size_t>(bin - firstBin) + 1, 0);
+        }
+        bins[static_cast<size_t>(bin - firstBin)] += n;
+    }
+
+public:
+    explicit QuantileSketch(double relativeAccuracy = 0.01)
+        : relativeAccuracy(relativeAccuracy),
+          gamma((1 + relativeAccuracy) / (1 - relativeAccuracy)),
+          logGamma(std::log(gamma)),
+          firstBin(0) {
+        if (!(relativeAccuracy > 0 && relativeAccuracy < 1)) {
+            throw std::invalid_argument("Sketch accuracy must be in (0, 1)");
+        }
+        clear();
+    }
+
+    void clear() {
+        bins.clear();
+        firstBin = 0;
+        zeroCount = 0;
+        total = 0;
+        sum = 0;
+        minValue = std::numeric_limits<SimTime>::max();
+        maxValue = 0;
+    }
+
+    double getRelativeAccuracy() const { return relativeAccuracy; }
+    // Counts of the nonzero latencies; bin getFirstBin() + i is getBins()[i]
+    int32_t getFirstBin() const { return firstBin; }
+    const std::vector<uint64_t>& getBins() const { return bins; }
+
+    void add(SimTime latency) {
+        SimTime v = std::max<SimTime>(latency, 0);
+        if (v == 0) {
+            zeroCount++;
+        } else {
+            addToBin(binOf(v), 1);
+        }
+        total++;
+        sum += v;
+        minValue = std::min(minValue, v);
+        maxValue = std::max(maxValue, v);
+    }
+
+    void merge(const QuantileSketch& other) {
+        if (other.relativeAccuracy != relativeAccuracy) {
+            throw std::invalid_argument("Cannot merge sketches with different accuracies");
+        }
+        if (other.total == 0) return;
+        for (size_t i = 0; i < other.bins.size(); ++i) {
+            if (other.bins[i]) addToBin(other.firstBin + static_cast<int32_t>(i), other.bins[i]);
+        }
+        zeroCount += other.zeroCount;
+        total += other.total;
+        sum += other.sum;
+        minValue = std::min(minValue, other.minValue);
+        maxValue = std::max(maxValue, other.maxValue);
+    }
+
+    uint64_t count() const { return total; }
+    int64_t totalNanoseconds() const { return sum; }
+    SimTime min() const { return total ? minValue : 0; }
+    SimTime max() const { return maxValue; }
+    double mean() const { return total ? static_cast<double>(sum) / total : 0; }
+
+    // Nearest-rank quantile (q in [0, 1]), clamped to the exact min and max
+    SimTime quantile(double q) const {
+        if (total == 0) return 0;
+        uint64_t rank = static_cast<uint64_t>(std::ceil(q * total));
+        rank = std::min(std::max<uint64_t>(rank, 1), total);
+        if (rank <= zeroCount) return 0;
+        uint64_t seen = zeroCount;
+        for (size_t i = 0; i < bins.size(); ++i) {
+            seen += bins[i];
+            if (seen >= rank) {
+                double estimate = 2 * std::pow(gamma, firstBin + static_cast<int32_t>(i)) / (gamma + 1);
+                SimTime v = static_cast<SimTime>(std::llround(estimate));
+                return std::min(std::max(v, minValue), maxValue);
+            }
+        }
+        return maxValue;
+    }
+
+    size_t memoryBytes() const { return bins.capacity() * sizeof(uint64_t); }
+};
+
+#endif
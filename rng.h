@@ -0,0 +1,338 @@
+#ifndef RNG_H
+#define RNG_H
+
+#include <cstddef>
+#include <cstdint>
+#include <stdexcept>
+#include <vector>
+
+#include "cpu_dispatch.h"
+#include "timeline.h"
+
+// Counter-based random numbers (Philox4x32-10, Salmon et al., SC'11).
+// A draw is a pure function of (seed, scenario, stream, draw index): there is
+// no shared generator state, so every station owns an independent stream and
+// results do not depend on how work is split across threads.
+
+// Identifies one simulation scenario under one user seed
+struct RngKey {
+    uint64_t seed = 1;
+    uint32_t scenario = 0;
+};
+
+// Stream id reserved for the access point's own draws
+constexpr uint32_t accessPointStream = 0xFFFFFFFFu;
+
+struct PhiloxBlock {
+    uint32_t v[4];
+};
+
+inline PhiloxBlock philox4x32(uint32_t c0, uint32_t c1, uint32_t c2, uint32_t c3, uint32_t k0, uint32_t k1) {
+    for (int round = 0; round < 10; ++round) {
+        uint64_t p0 = static_cast<uint64_t>(0xD2511F53u) * c0;
+        uint64_t p1 = static_cast<uint64_t>(0xCD9E8D57u) * c2;
+        uint32_t n0 = static_cast<uint32_t>(p1 >> 32) ^ c1 ^ k0;
+        uint32_t n2 = static_cast<uint32_t>(p0 >> 32) ^ c3 ^ k1;
+        c1 = static_cast<uint32_t>(p1);
+        c3 = static_cast<uint32_t>(p0);
+        c0 = n0;
+        c2 = n2;
+        k0 += 0x9E3779B9u;
+        k1 += 0xBB67AE85u;
+    }
+    return PhiloxBlock{{c0, c1, c2, c3}};
+}
+
+// Draws a stream can give. The batched kernels and the station table keep
+// 32-bit draw indices, so a stream stops at 2^32 - 1 draws and throws
+// rather than wrap around and repeat itself.
+constexpr uint64_t maxStreamDraws = UINT32_MAX;
+
+inline uint32_t checkedDrawIndex(uint64_t draw) {
+    if (draw >= maxStreamDraws) throw std::overflow_error("random stream exhausted after 2^32 - 1 draws");
+    return static_cast<uint32_t>(draw);
+}
+
+// The draw-th 32-bit value of a stream
+inline uint32_t counterDraw(const RngKey& key, uint32_t stream, uint64_t draw) {
+    return philox4x32(static_cast<uint32_t>(draw), static_cast<uint32_t>(draw >> 32), stream, key.scenario,
+                      static_cast<uint32_t>(key.seed), static_cast<uint32_t>(key.seed >> 32)).v[0];
+}
+
+// Maps a 32-bit draw onto [0, n) with a multiply instead of a modulo
+inline uint32_t scaleDraw(uint32_t draw, uint32_t n) {
+    return static_cast<uint32_t>((static_cast<uint64_t>(draw) * n) >> 32);
+}
+
+// Where the draws of a batch take their scenario from: one for the whole
+// batch, or an array with one per draw (lockstep lanes)
+struct SharedScenario {
+    uint32_t id;
+};
+
+inline uint32_t scenarioAt(SharedScenario scenario, size_t) { return scenario.id; }
+inline uint32_t scenarioAt(const uint32_t* scenarios, size_t i) { return scenarios[i]; }
+inline SharedScenario scenariosFrom(SharedScenario scenario, size_t) { return scenario; }
+inline const uint32_t* scenariosFrom(const uint32_t* scenarios, size_t i) { return scenarios + i; }
+
+// Batched generation: out[i] = counterDraw({seed, scenario of i}, streams[i], draws[i]).
+// Draw indices are 32-bit (see maxStreamDraws). The vector paths run 8
+// (AVX2) or 16 (AVX-512) Philox blocks side by side and return exactly the
+// scalar values.
+template <class Scenarios>
+inline void counterDrawBatchScalar(uint64_t seed, Scenarios scenarios, const uint32_t* streams,
+                                   const uint32_t* draws, uint32_t* out, size_t n) {
+    for (size_t i = 0; i < n; ++i) {
+        out[i] = philox4x32(draws[i], 0, streams[i], scenarioAt(scenarios, i),
+                            static_cast<uint32_t>(seed), static_cast<uint32_t>(seed >> 32)).v[0];
+    }
+}
+
+#if WIFI_X86_SIMD
+// 32x32 -> 64 bit products of every lane, split into high and low halves
+__attribute__((target("avx2")))
+inline void mulHiLoAvx2(__m256i a, __m256i m, __m256i& hi, __m256i& lo) {
+    __m256i even = _mm256_mul_epu32(a, m);
+    __m256i odd = _mm256_mul_epu32(_mm256_srli_epi64(a, 32), m);
+    lo = _mm256_blend_epi32(even, _mm256_slli_epi64(odd, 32), 0xAA);
+    hi = _mm256_blend_epi32(_mm256_srli_epi64(even, 32), odd, 0xAA);
+}
+
+__attribute__((target("avx2")))
+inline __m256i scenariosAvx2(SharedScenario scenario, size_t) { return _mm256_set1_epi32(static_cast<int>(scenario.id)); }
+
+__attribute__((target("avx2")))
+inline __m256i scenariosAvx2(const uint32_t* scenarios, size_t i) {
+    return _mm256_loadu_si256(reinterpret_cast<const __m256i*>(scenarios + i));
+}
+
+template <class Scenarios>
+__attribute__((target("avx2")))
+inline void counterDrawBatchAvx2(uint64_t seed, Scenarios scenarios, const uint32_t* streams,
+                                 const uint32_t* draws, uint32_t* out, size_t n) {
+    const __m256i m0 = _mm256_set1_epi32(static_cast<int>(0xD2511F53u));
+    const __m256i m1 = _mm256_set1_epi32(static_cast<int>(0xCD9E8D57u));
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        __m256i c0 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(draws + i));
+        __m256i c1 = _mm256_setzero_si256();
+        __m256i c2 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(streams + i));
+        __m256i c3 = scenariosAvx2(scenarios, i);
+        uint32_t k0 = static_cast<uint32_t>(seed), k1 = static_cast<uint32_t>(seed >> 32);
+        for (int round = 0; round < 10; ++round) {
+            __m256i hi0, lo0, hi1, lo1;
+            mulHiLoAvx2(c0, m0, hi0, lo0);
+            mulHiLoAvx2(c2, m1, hi1, lo1);
+            c0 = _mm256_xor_si256(_mm256_xor_si256(hi1, c1), _mm256_set1_epi32(static_cast<int>(k0)));
+            c2 = _mm256_xor_si256(_mm256_xor_si256(hi0, c3), _mm256_set1_epi32(static_cast<int>(k1)));
+            c1 = lo1;
+            c3 = lo0;
+            k0 += 0x9E3779B9u;
+            k1 += 0xBB67AE85u;
+        }
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + i), c0);
+    }
+    counterDrawBatchScalar(seed, scenariosFrom(scenarios, i), streams + i, draws + i, out + i, n - i);
+}
+
+// GCC 12 flags the intrinsics' own _mm512_undefined_epi32() placeholders
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wmaybe-uninitialized"
+__attribute__((target("avx512f")))
+inline void mulHiLoAvx512(__m512i a, __m512i m, __m512i& hi, __m512i& lo) {
+    __m512i even = _mm512_mul_epu32(a, m);
+    __m512i odd = _mm512_mul_epu32(_mm512_srli_epi64(a, 32), m);
+    lo = _mm512_mask_blend_epi32(0xAAAA, even, _mm512_slli_epi64(odd, 32));
+    hi = _mm512_mask_blend_epi32(0xAAAA, _mm512_srli_epi64(even, 32), odd);
+}
+
+__attribute__((target("avx512f")))
+inline __m512i scenariosAvx512(SharedScenario scenario, size_t) { return _mm512_set1_epi32(static_cast<int>(scenario.id)); }
+
+__attribute__((target("avx512f")))
+inline __m512i scenariosAvx512(const uint32_t* scenarios, size_t i) { return _mm512_loadu_si512(scenarios + i); }
+
+template <class Scenarios>
+__attribute__((target("avx512f")))
+inline void counterDrawBatchAvx512(uint64_t seed, Scenarios scenarios, const uint32_t* streams,
+                                   const uint32_t* draws, uint32_t* out, size_t n) {
+    const __m512i m0 = _mm512_set1_epi32(static_cast<int>(0xD2511F53u));
+    const __m512i m1 = _mm512_set1_epi32(static_cast<int>(0xCD9E8D57u));
+    size_t i = 0;
+    for (; i + 16 <= n; i += 16) {
+        __m512i c0 = _mm512_loadu_si512(draws + i);
+        __m512i c1 = _mm512_setzero_si512();
+        __m512i c2 = _mm512_loadu_si512(streams + i);
+        __m512i c3 = scenariosAvx512(scenarios, i);
+        uint32_t k0 = static_cast<uint32_t>(seed), k1 = static_cast<uint32_t>(seed >> 32);
+        for (int round = 0; round < 10; ++round) {
+            __m512i hi0, lo0, hi1, lo1;
+            mulHiLoAvx512(c0, m0, hi0, lo0);
+            mulHiLoAvx512(c2, m1, hi1, lo1);
+            c0 = _mm512_xor_si512(_mm512_xor_si512(hi1, c1), _mm512_set1_epi32(static_cast<int>(k0)));
+            c2 = _mm512_xor_si512(_mm512_xor_si512(hi0, c3), _mm512_set1_epi32(static_cast<int>(k1)));
+            c1 = lo1;
+            c3 = lo0;
+            k0 += 0x9E3779B9u;
+            k1 += 0xBB67AE85u;
+        }
+        _mm512_storeu_si512(out + i, c0);
+    }
+    counterDrawBatchAvx2(seed, scenariosFrom(scenarios, i), streams + i, draws + i, out + i, n - i);
+}
+#pragma GCC diagnostic pop
+#endif
+
+template <class Scenarios>
+inline void counterDrawBatch(uint64_t seed, Scenarios scenarios, const uint32_t* streams, const uint32_t* draws,
+                             uint32_t* out, size_t n) {
+#if WIFI_X86_SIMD
+    switch (activeSimdLevel()) {
+    case SimdLevel::AVX512: counterDrawBatchAvx512(seed, scenarios, streams, draws, out, n); return;
+    case SimdLevel::AVX2: counterDrawBatchAvx2(seed, scenarios, streams, draws, out, n); return;
+    default: break;
+    }
+#endif
+    counterDrawBatchScalar(seed, scenarios, streams, draws, out, n);
+}
+
+// Every draw under one key, the usual case
+inline void counterDrawBatch(const RngKey& key, const uint32_t* streams, const uint32_t* draws, uint32_t* out,
+                             size_t n) {
+    counterDrawBatch(key.seed, SharedScenario{key.scenario}, streams, draws, out, n);
+}
+
+// Buffer of pending draw requests under one key. Callers reserve draws from
+// their streams, generate() produces all of them in one vectorized pass, and
+// the values are read back by request index. A request takes 12 bytes.
+class RngBatch {
+private:
+    RngKey key;
+    std::vector<uint32_t> streams;
+    std::vector<uint32_t> draws;
+    std::vector<uint32_t> values;
+
+public:
+    explicit RngBatch(const RngKey& key = RngKey()) : key(key) {}
+
+    void setKey(const RngKey& newKey) { key = newKey; clear(); }
+
+    size_t request(uint32_t stream, uint32_t draw) {
+        streams.push_back(stream);
+        draws.push_back(draw);
+        return draws.size() - 1;
+    }
+
+    size_t size() const { return draws.size(); }
+
+    void generate() {
+        HotTimelineScope span("rng refill", "rng");
+        span.arg("draws", static_cast<int64_t>(draws.size()));
+        if (values.size() < draws.size()) values.resize(draws.size());   // kept by clear()
+        counterDrawBatch(key, streams.data(), draws.data(), values.data(), draws.size());
+    }
+
+    uint32_t operator[](size_t i) const { return values[i]; }
+
+    size_t memoryBytes() const {
+        return (streams.capacity() + draws.capacity() + values.capacity()) * sizeof(uint32_t);
+    }
+
+    void clear() {
+        streams.clear();
+        draws.clear();
+    }
+};
+
+// RngBatch for draws under several scenarios of one seed, as the lockstep
+// runner's lanes (replications of one cell) make them: setScenario()
+// applies to the requests that follow. A request takes 16 bytes, but the
+// batch only holds one step's redraws, a few per lane.
+class LaneRngBatch {
+private:
+    uint64_t seed;
+    uint32_t scenario;
+    std::vector<uint32_t> scenarios;
+    std::vector<uint32_t> streams;
+    std::vector<uint32_t> draws;
+    std::vector<uint32_t> values;
+
+public:
+    explicit LaneRngBatch(uint64_t seed = 1) : seed(seed), scenario(0) {}
+
+    void setSeed(uint64_t newSeed) { seed = newSeed; clear(); }
+    void setScenario(uint32_t newScenario) { scenario = newScenario; }
+
+    size_t request(uint32_t stream, uint32_t draw) {
+        scenarios.push_back(scenario);
+        streams.push_back(stream);
+        draws.push_back(draw);
+        return draws.size() - 1;
+    }
+
+    size_t size() const { return draws.size(); }
+
+    void generate() {
+        HotTimelineScope span("rng refill", "rng");
+        span.arg("draws", static_cast<int64_t>(draws.size()));
+        if (values.size() < draws.size()) values.resize(draws.size());
+        counterDrawBatch(seed, scenarios.data(), streams.data(), draws.data(), values.data(), draws.size());
+    }
+
+    uint32_t operator[](size_t i) const { return values[i]; }
+
+    void clear() {
+        scenarios.clear();
+        streams.clear();
+        draws.clear();
+    }
+};
+
+// One station's stream: the key plus a draw counter
+class RandomStream {
+private:
+    RngKey key;
+    uint32_t stream;
+    uint64_t drawIndex;
+
+    uint32_t takeDraw() {
+        uint32_t draw = checkedDrawIndex(drawIndex);
+        ++drawIndex;
+        return draw;
+    }
+
+public:
+    RandomStream(const RngKey& key = RngKey(), uint32_t stream = 0) : key(key), stream(stream), drawIndex(0) {}
+
+    uint32_t next() { return counterDraw(key, stream, takeDraw()); }
+
+    // Hands the next draw to a batch instead of computing it here. The
+    // batch must use this stream's key.
+    size_t reserve(RngBatch& batch) { return batch.request(stream, takeDraw()); }
+
+    // Uniform integer in [0, n)
+    uint32_t uniformInt(uint32_t n) { return scaleDraw(next(), n); }
+
+    uint64_t position() const { return drawIndex; }
+};
+
+// Folds scenario parameters into a scenario id, so a scenario draws the same
+// numbers whatever order or thread it runs in
+inline uint32_t scenarioId(uint32_t generation, uint32_t numClients, uint32_t numPackets) {
+    uint64_t h = 0x9E3779B97F4A7C15ull;
+    for (uint32_t part : {generation, numClients, numPackets}) {
+        h = (h ^ part) * 0xBF58476D1CE4E5B9ull;
+        h ^= h >> 31;
+    }
+    return static_cast<uint32_t>(h);
+}
+
+// Scenario id of an independent replication. Replication 0 is the scenario
+// itself, so a single run draws the same numbers as before.
+inline uint32_t replicationScenario(uint32_t scenario, uint32_t replication) {
+    if (replication == 0) return scenario;
+    uint64_t h = (static_cast<uint64_t>(scenario) << 32 | replication) * 0x94D049BB133111EBull;
+    return static_cast<uint32_t>(h ^ (h >> 29));
+}
+
+#endif
@@ -0,0 +1,507 @@
+#ifndef SCENARIO_RUNNER_H
+#define SCENARIO_RUNNER_H
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <ctime>
+#include <istream>
+#include <memory>
+#include <numeric>
+#include <ostream>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "access_points.h"
+#include "sweep.h"
+#include "work_stealing.h"
+
+// How WiFi 4 stations contend for the channel
+enum class ContentionEngine { EventDriven, Slotted, Lockstep };
+
+// Settings shared by every simulation run
+struct SimulationOptions {
+    QueueBackend queueBackend = QueueBackend::BinaryHeap;
+    ContentionEngine contention = ContentionEngine::EventDriven;
+    int replications = 1;   // independent runs of each cell
+    int latencyPrecisionBits = 8;
+    StoppingRule stopping;   // off unless --ci-target is given
+    bool truncateWarmup = true;   // WiFi 4: drop the MSER-5 warm-up
+    uint64_t seed = 1;
+    int threads = 1;              // workers for a sweep; 0: one per hardware thread
+    TraceWriter* trace = nullptr; // per-packet trace (--trace), shared by every worker
+    const ArrivalTrace* arrivals = nullptr;   // replayed traffic (--arrivals); saturated when null
+};
+
+// Every scenario draws from its own streams under the user's seed
+inline RngKey scenarioKey(uint64_t seed, int generation, int numClients, int numPackets) {
+    RngKey key;
+    key.seed = seed;
+    key.scenario = scenarioId(generation, numClients, numPackets);
+    return key;
+}
+
+inline RngKey replicationKey(uint64_t seed, int generation, int numClients, int numPackets, int replication) {
+    RngKey key = scenarioKey(seed, generation, numClients, numPackets);
+    key.scenario = replicationScenario(key.scenario, static_cast<uint32_t>(replication));
+    return key;
+}
+
+// WiFi 6 channel
+constexpr double wifi6Bandwidth = 20e6;         // 20 MHz channel
+constexpr double wifi6BitsPerSymbol = 8.0;      // 256-QAM
+constexpr double wifi6CodingRate = 5.0 / 6.0;   // Coding rate 5/6
+
+// Identifies one replication's packets in the trace
+inline TraceBlockHeader traceRun(const Scenario& scenario, int replication) {
+    TraceBlockHeader run = {};
+    run.generation = static_cast<uint16_t>(scenario.generation);
+    run.mcs = static_cast<uint16_t>(scenario.mcs);
+    run.clients = static_cast<uint32_t>(scenario.clients);
+    run.packets = static_cast<uint32_t>(scenario.packets);
+    run.replication = static_cast<uint32_t>(replication);
+    run.seed = scenario.seed;
+    return run;
+}
+
+// What one scenario, or a run of its replications, produced
+struct ScenarioOutcome {
+    std::vector<SimulationResult> results;   // one per replication, in order
+    QuantileSketch latencies;                 // merged over the replications, in order
+    std::string report;                       // the interactive report, when requested
+    std::string profile;                      // per-run counters and phase costs, when profiling without a report
+};
+
+// Runs scenarios back to back. The access points keep their station
+// tables, event queues and histograms between runs, so a worker only
+// allocates when a cell is larger than every one before it. Nothing is
+// printed: the interactive report, when asked for, is kept as text in the
+// outcome.
+class ScenarioWorkspace {
+private:
+    SimulationOptions options;
+    WiFi4AccessPoint wifi4;
+    WiFi5AccessPoint wifi5;
+    WiFi6AccessPoint wifi6;
+    std::vector<WiFi6User> wifi6Users;
+    std::unique_ptr<WiFi4LockstepRunner> lockstep;   // created on first use
+    std::unique_ptr<PacketTracer> tracer;            // this worker's trace buffers
+    std::vector<RngKey> keys;
+    std::ostringstream profile;                       // profiles of runs without a report
+
+    // Counters and phase costs of one run (instrumented builds, --perf-counters),
+    // after its report or, without one, for the batch to print
+    static bool profiling() { return instrumentationEnabled || perfCountersRequested(); }
+
+    static void resetProfile() {
+        resetHotPathStats();
+        resetPerfPhaseCounts();
+    }
+
+    void printProfile(std::ostream* report, uint64_t packets) {
+        std::ostream* out = report ? report : (profiling() ? &profile : nullptr);
+        if (!out) return;
+        printHotPathStats(*out);
+        printPerfCounters(*out, packets);
+    }
+
+    // WiFi 4 replications in lockstep across vector lanes
+    void runLockstep(const Scenario& scenario, int first, int count, ScenarioOutcome& outcome, std::ostream* report) {
+        if (!lockstep) {
+            lockstep.reset(new WiFi4LockstepRunner);
+            lockstep->setLatencyPrecision(options.latencyPrecisionBits);
+            lockstep->setStoppingRule(options.stopping);
+            lockstep->setWarmupTruncation(options.truncateWarmup);
+            if (options.trace) lockstep->setTraceWriter(options.trace);
+        }
+        resetProfile();
+        keys.clear();
+        for (int r = first; r < first + count; ++r) {
+            keys.push_back(replicationKey(scenario.seed, 4, scenario.clients, scenario.packets, r));
+        }
+        lockstep->setMcs(scenario.mcs);
+        lockstep->setTraceRun(traceRun(scenario, first));
+        {
+            RunPhaseTimer timer(SimPhase::Simulate);
+            TimelineScope span("lockstep run", "scenario");
+            span.arg("clients", scenario.clients).arg("first", first).arg("count", count);
+            lockstep->run(keys, scenario.clients, scenario.packets);
+        }
+        {
+            RunPhaseTimer timer(SimPhase::Report);
+            for (int i = 0; i < count; ++i) {
+                if (report && options.replications > 1) *report << "Replication " << first + i << ":\n";
+                if (report) *report << lockstep->getReports()[i];
+                outcome.latencies.merge(lockstep->getSketches()[i]);
+                outcome.results.push_back(lockstep->getResults()[i]);
+            }
+            if (report) lockstep->displayEngineStats(*report, keys.size());
+        }
+        uint64_t packets = 0;
+        for (const SimulationResult& result : outcome.results) packets += result.delivered + result.dropped;
+        printProfile(report, packets);   // the whole group, setup included in simulate
+    }
+
+    void runWiFi4(const Scenario& scenario, const RngKey& key, SimulationResult& result, std::ostream* report) {
+        resetProfile();
+        {
+            RunPhaseTimer timer(SimPhase::Setup);
+            wifi4.clearClients();
+            wifi4.setMcs(scenario.mcs);
+            wifi4.setRandomKey(key);
+            wifi4.reserveClients(scenario.clients);
+            for (int i = 0; i < scenario.clients; ++i) {
+                wifi4.addClient(WiFiUser(i, key));
+            }
+        }
+        {
+            RunPhaseTimer timer(SimPhase::Simulate);
+            if (options.contention == ContentionEngine::Slotted && !options.arrivals) {
+                wifi4.simulateSlotted(scenario.packets);
+            } else {
+                wifi4.simulateNetwork(scenario.packets);
+            }
+        }
+        {
+            RunPhaseTimer timer(SimPhase::Report);
+            if (report) wifi4.displayStatistics(*report);
+            wifi4.fillResult(result);
+        }
+        printProfile(report, result.delivered + result.dropped);
+    }
+
+    void runWiFi5(const Scenario& scenario, const RngKey& key, SimulationResult& result, std::ostream* report) {
+        resetProfile();
+        {
+            RunPhaseTimer timer(SimPhase::Setup);
+            wifi5.clearUsers();
+            wifi5.setMcs(scenario.mcs);
+            wifi5.setRandomKey(key);
+            wifi5.reserveUsers(scenario.clients);
+            for (int i = 0; i < scenario.clients; ++i) {
+                wifi5.registerUser(WiFiUser(i, key));
+            }
+        }
+        {
+            RunPhaseTimer timer(SimPhase::Simulate);
+            wifi5.simulateMU_MIMO(scenario.packets);
+        }
+        {
+            RunPhaseTimer timer(SimPhase::Report);
+            if (report) wifi5.displayStatistics(*report);
+            wifi5.fillResult(result);
+        }
+        printProfile(report, result.delivered + result.dropped);
+    }
+
+    void runWiFi6(const Scenario& scenario, const RngKey& key, SimulationResult& result, std::ostream* report) {
+        resetProfile();
+        {
+            RunPhaseTimer timer(SimPhase::Setup);
+            while (wifi6Users.size() < static_cast<size_t>(scenario.clients)) {
+                wifi6Users.emplace_back(static_cast<int>(wifi6Users.size()));
+            }
+            wifi6.clearUsers();
+            wifi6.setMcs(scenario.mcs);
+            wifi6.setRandomKey(key);
+            for (int i = 0; i < scenario.clients; ++i) {
+                wifi6Users[i].allocateSubChannel(-1);
+                wifi6.registerUser(&wifi6Users[i]);
+            }
+        }
+        {
+            RunPhaseTimer timer(SimPhase::Simulate);
+            wifi6.simulateOFDMA(scenario.packets);
+        }
+        {
+            RunPhaseTimer timer(SimPhase::Report);
+            if (report) wifi6.displayStatistics(*report);
+            wifi6.fillResult(result);
+        }
+        printProfile(report, result.delivered + result.dropped);
+    }
+
+public:
+    explicit ScenarioWorkspace(const SimulationOptions& options)
+        : options(options), wifi6(wifi6Bandwidth, wifi6BitsPerSymbol, wifi6CodingRate) {
+        wifi4.setQueueBackend(options.queueBackend);
+        wifi4.setLatencyPrecision(options.latencyPrecisionBits);
+        wifi4.setStoppingRule(options.stopping);
+        wifi4.setWarmupTruncation(options.truncateWarmup);
+        wifi5.setQueueBackend(options.queueBackend);
+        wifi5.setLatencyPrecision(options.latencyPrecisionBits);
+        wifi5.setStoppingRule(options.stopping);
+        wifi6.setQueueBackend(options.queueBackend);
+        wifi6.setLatencyPrecision(options.latencyPrecisionBits);
+        wifi6.setStoppingRule(options.stopping);
+        if (options.trace) {
+            tracer.reset(new PacketTracer(*options.trace));
+            wifi4.setTracer(tracer.get());
+            wifi5.setTracer(tracer.get());
+            wifi6.setTracer(tracer.get());
+        }
+        wifi4.setArrivals(options.arrivals);
+        wifi5.setArrivals(options.arrivals);
+        wifi6.setArrivals(options.arrivals);
+    }
+
+    // Replications [first, first + count) of a scenario, each on its own
+    // streams, replacing `outcome`. The wall time of a lockstep group is
+    // shared evenly among its replications.
+    void run(const Scenario& scenario, int first, int count, ScenarioOutcome& outcome, bool withReport) {
+        outcome.results.clear();
+        outcome.latencies.clear();
+        std::ostringstream report;
+        std::ostream* out = withReport ? &report : nullptr;
+        profile.str("");
+        if (!out && profiling()) {
+            profile << "WiFi " << scenario.generation << ", " << scenario.clients << " clients, " << scenario.packets
+                    << " packets, MCS " << scenario.mcs << ", seed " << scenario.seed << ", replication " << first;
+            if (count > 1) profile << "-" << first + count - 1;
+            profile << ":\n";
+        }
+        auto start = std::chrono::steady_clock::now();
+        // Replayed traffic runs on the event engine only
+        if (scenario.generation == 4 && options.contention == ContentionEngine::Lockstep && !options.arrivals) {
+            runLockstep(scenario, first, count, outcome, out);
+            double wallSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+            for (SimulationResult& result : outcome.results) result.wallSeconds = wallSeconds / count;
+        } else {
+            for (int r = first; r < first + count; ++r) {
+                if (out && options.replications > 1) *out << "Replication " << r << ":\n";
+                RngKey key = replicationKey(scenario.seed, scenario.generation, scenario.clients, scenario.packets, r);
+                outcome.results.emplace_back();
+                SimulationResult& result = outcome.results.back();
+                if (tracer) tracer->beginRun(traceRun(scenario, r));
+                {
+                    TimelineScope span("run", "scenario");
+                    span.arg("generation", scenario.generation).arg("clients", scenario.clients).arg("replication", r);
+                    if (scenario.generation == 4) {
+                        runWiFi4(scenario, key, result, out);
+                    } else if (scenario.generation == 5) {
+                        runWiFi5(scenario, key, result, out);
+                    } else {
+                        runWiFi6(scenario, key, result, out);
+                    }
+                }
+                {
+                    TimelineScope span("merge sketch", "stats");
+                    outcome.latencies.merge(scenario.generation == 4   ? wifi4.getLatencySketch()
+                                            : scenario.generation == 5 ? wifi5.getLatencySketch()
+                                                                       : wifi6.getLatencySketch());
+                }
+                if (tracer) tracer->endRun();
+                auto now = std::chrono::steady_clock::now();
+                result.wallSeconds = std::chrono::duration<double>(now - start).count();
+                start = now;
+            }
+        }
+        outcome.report = report.str();
+        outcome.profile = profile.str();
+        for (size_t i = 0; i < outcome.results.size(); ++i) {
+            SimulationResult& result = outcome.results[i];
+            result.generation = scenario.generation;
+            result.clients = scenario.clients;
+            result.packets = scenario.packets;
+            result.mcs = scenario.mcs;
+            result.seed = scenario.seed;
+            result.replication = first + static_cast<int>(i);
+        }
+    }
+};
+
+// Mean and confidence-interval half-width of one metric across
+// independent replications (Student t with R - 1 degrees of freedom)
+struct ReplicationEstimate {
+    double mean;
+    double halfWidth;   // infinite with fewer than two replications
+};
+
+template <typename Metric>
+ReplicationEstimate estimateAcrossReplications(const std::vector<SimulationResult>& results, double confidence,
+                                               Metric metric) {
+    RunningStats stats;
+    for (const SimulationResult& result : results) stats.add(metric(result));
+    double halfWidth = stats.count() > 1
+        ? studentTCritical(confidence, stats.count() - 1) * stats.stddev() / std::sqrt(static_cast<double>(stats.count()))
+        : INFINITY;
+    return ReplicationEstimate{stats.mean(), halfWidth};
+}
+
+// Across-replication confidence intervals for a scenario's headline metrics
+inline void printReplicationIntervals(std::ostream& out, const std::vector<SimulationResult>& results, double confidence) {
+    ReplicationEstimate throughput = estimateAcrossReplications(results, confidence,
+        [](const SimulationResult& r) { return r.throughputMbps; });
+    ReplicationEstimate latency = estimateAcrossReplications(results, confidence,
+        [](const SimulationResult& r) { return r.meanLatencyMs; });
+    ReplicationEstimate tail = estimateAcrossReplications(results, confidence,
+        [](const SimulationResult& r) { return r.p99LatencyMs; });
+    out << confidence * 100 << "% CI over " << results.size() << " replications: Throughput " << throughput.mean
+        << " +- " << throughput.halfWidth << " Mbps, Average Latency " << latency.mean << " +- " << latency.halfWidth
+        << " ms, p99 Latency " << tail.mean << " +- " << tail.halfWidth << " ms\n";
+}
+
+// CPU time consumed by the calling thread; wall time where the platform has
+// no per-thread clock
+inline double threadCpuSeconds() {
+#ifdef CLOCK_THREAD_CPUTIME_ID
+    timespec t;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &t);
+    return t.tv_sec + t.tv_nsec * 1e-9;
+#else
+    return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+#endif
+}
+
+// How well a batch of runs used its threads: the CPU time the workers spent
+// on tasks over threads x elapsed time, so oversubscribed cores show up as
+// lost efficiency. Runs slowed down by sharing caches or memory bandwidth
+// still count as busy, so this is an upper bound on the speedup over one
+// thread, divided by the thread count.
+struct RunnerStats {
+    size_t tasks = 0;
+    int threads = 0;
+    double wallSeconds = 0;
+    double busySeconds = 0;
+
+    double efficiency() const { return wallSeconds > 0 ? busySeconds / (threads * wallSeconds) : 0; }
+};
+
+inline void printRunnerStats(std::ostream& out, const RunnerStats& stats) {
+    out << "Runner (" << stats.threads << " threads): " << stats.tasks << " tasks, " << stats.busySeconds * 1000
+        << " ms of work in " << stats.wallSeconds * 1000 << " ms, scaling efficiency " << stats.efficiency() * 100
+        << "%\n";
+}
+
+// Runs every replication of every scenario on a work-stealing pool with
+// one workspace per worker. Each replication is a task, except that
+// lockstep WiFi 4 replications go in groups that keep the vector lanes
+// busy. The largest tasks (clients x packets x replications) are dealt
+// first, so a 10k-client cell starts early and the 1-client ones fill the
+// gaps around it. Outcomes are merged per scenario in replication order,
+// so they are identical whatever the thread count or the timing.
+inline std::vector<ScenarioOutcome> runScenarios(const std::vector<Scenario>& scenarios, const SimulationOptions& options,
+                                                 bool withReports, RunnerStats& stats) {
+    struct Task {
+        size_t scenario;
+        int first;
+        int count;
+    };
+    const int replications = std::max(options.replications, 1);
+    const int lockstepGroup = 4 * lockstepLanes;
+    std::vector<Task> tasks;
+    for (size_t s = 0; s < scenarios.size(); ++s) {
+        bool grouped = scenarios[s].generation == 4 && options.contention == ContentionEngine::Lockstep &&
+                       !options.arrivals;
+        int group = grouped ? lockstepGroup : 1;
+        for (int first = 0; first < replications; first += group) {
+            tasks.push_back(Task{s, first, std::min(group, replications - first)});
+        }
+    }
+    auto cost = [&](const Task& t) {
+        return static_cast<double>(scenarios[t.scenario].clients) * scenarios[t.scenario].packets * t.count;
+    };
+    std::vector<size_t> order(tasks.size());
+    std::iota(order.begin(), order.end(), 0);
+    std::stable_sort(order.begin(), order.end(), [&](size_t a, size_t b) { return cost(tasks[a]) > cost(tasks[b]); });
+
+    auto start = std::chrono::steady_clock::now();
+    std::vector<ScenarioOutcome> taskOutcomes(tasks.size());
+    WorkStealingPool pool(static_cast<int>(std::min<size_t>(std::max(options.threads, 1), std::max<size_t>(tasks.size(), 1))));
+    std::vector<std::unique_ptr<ScenarioWorkspace>> workspaces(pool.size());
+    std::vector<double> busySeconds(pool.size(), 0.0);
+    pool.run(order, [&](size_t task, int worker) {
+        double cpuStart = threadCpuSeconds();
+        Timeline::instance().nameThread("worker", worker);
+        TimelineScope span("task", "sweep");
+        span.arg("scenario", static_cast<int64_t>(tasks[task].scenario)).arg("first", tasks[task].first);
+        if (!workspaces[worker]) workspaces[worker].reset(new ScenarioWorkspace(options));
+        const Task& t = tasks[task];
+        workspaces[worker]->run(scenarios[t.scenario], t.first, t.count, taskOutcomes[task], withReports);
+        busySeconds[worker] += threadCpuSeconds() - cpuStart;
+    });
+    stats.tasks = tasks.size();
+    stats.threads = pool.size();
+    stats.wallSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    stats.busySeconds = std::accumulate(busySeconds.begin(), busySeconds.end(), 0.0);
+
+    // Tasks were listed scenario by scenario in replication order
+    TimelineScope span("merge outcomes", "stats");
+    std::vector<ScenarioOutcome> outcomes(scenarios.size());
+    for (size_t i = 0; i < tasks.size(); ++i) {
+        ScenarioOutcome& outcome = outcomes[tasks[i].scenario];
+        const ScenarioOutcome& part = taskOutcomes[i];
+        outcome.results.insert(outcome.results.end(), part.results.begin(), part.results.end());
+        outcome.latencies.merge(part.latencies);
+        outcome.report += part.report;
+        outcome.profile += part.profile;
+    }
+    if (withReports && replications > 1) {
+        for (ScenarioOutcome& outcome : outcomes) {
+            std::ostringstream summary;
+            printSketchSummary(summary, "Merged over " + std::to_string(replications) + " replications", outcome.latencies);
+            printReplicationIntervals(summary, outcome.results, options.stopping.confidence);
+            outcome.report += summary.str();
+        }
+    }
+    return outcomes;
+}
+
+inline void validateScenario(const Scenario& scenario) {
+    if (scenario.generation < 4 || scenario.generation > 6) {
+        throw std::invalid_argument("generation must be 4, 5 or 6");
+    }
+    if (scenario.clients < 1) {
+        throw std::invalid_argument("a scenario needs at least one client");
+    }
+    if (scenario.packets < 0) {
+        throw std::invalid_argument("packet count must not be negative");
+    }
+    if (scenario.mcs < 0 || scenario.mcs > maxMcs(scenario.generation)) {
+        throw std::invalid_argument("MCS must be 0-" + std::to_string(maxMcs(scenario.generation)) + " for WiFi " +
+                                    std::to_string(scenario.generation));
+    }
+}
+
+// Scenario list. A line is either one scenario, "generation clients packets
+// [seed [mcs]]", or a sweep such as "generation=4 clients=1:100:9 mcs=0:9"
+// whose axes default to `defaults` (the generation must be given). Blank
+// lines and '#' comments are skipped.
+inline std::vector<Scenario> readScenarios(std::istream& in, const std::string& name, const SweepSpec& defaults) {
+    std::vector<Scenario> scenarios;
+    std::string line;
+    for (int lineNumber = 1; std::getline(in, line); ++lineNumber) {
+        line = line.substr(0, line.find('#'));
+        std::istringstream fields(line);
+        if ((fields >> std::ws).eof()) continue;
+        size_t first = scenarios.size();
+        try {
+            if (line.find('=') != std::string::npos) {
+                SweepSpec sweep = defaults;
+                sweep.generations.clear();
+                sweep.parse(line);
+                if (sweep.generations.empty()) throw std::invalid_argument("a sweep needs generation=...");
+                sweep.expand(scenarios);
+            } else {
+                Scenario scenario{0, 0, 0, defaultMcs, static_cast<uint64_t>(defaults.seeds.front())};
+                bool valid = static_cast<bool>(fields >> scenario.generation >> scenario.clients >> scenario.packets);
+                if (valid && !(fields >> std::ws).eof()) valid = static_cast<bool>(fields >> scenario.seed);
+                if (valid && !(fields >> std::ws).eof()) valid = static_cast<bool>(fields >> scenario.mcs);
+                if (!valid || !(fields >> std::ws).eof()) {
+                    throw std::invalid_argument("expected 'generation clients packets [seed [mcs]]' or name=values");
+                }
+                scenarios.push_back(scenario);
+            }
+            for (size_t i = first; i < scenarios.size(); ++i) {
+                validateScenario(scenarios[i]);
+            }
+        } catch (const std::invalid_argument& e) {
+            throw std::invalid_argument(name + ":" + std::to_string(lineNumber) + ": " + e.what());
+        }
+    }
+    return scenarios;
+}
+
+#endif
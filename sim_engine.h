@@ -0,0 +1,304 @@
+#ifndef SIM_ENGINE_H
+#define SIM_ENGINE_H
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+// Simulated time in integer nanoseconds. Integer ticks keep slot arithmetic
+// exact, so stations whose backoff ends in the same slot really tie.
+using SimTime = int64_t;
+
+constexpr SimTime nanoseconds(int64_t n) { return n; }
+constexpr SimTime microseconds(int64_t us) { return us * 1000; }
+constexpr double toMilliseconds(SimTime t) { return t / 1e6; }
+constexpr double toSeconds(SimTime t) { return t / 1e9; }
+
+// A timestamped simulation event. Events are ordered by time; events that
+// share a timestamp run in the order they were scheduled.
+struct Event {
+    SimTime time;
+    uint64_t seq;
+    int32_t target;            // station / user index, -1 for the access point
+    uint32_t type : 8;
+    uint32_t generation : 24;  // 0 for events that cannot be cancelled
+};
+
+// Handle to a cancellable event. Cancelling bumps the target's generation
+// counter; the stale event stays queued and is discarded when popped.
+struct EventHandle {
+    int32_t target = -1;
+    uint32_t generation = 0;
+};
+
+inline bool operator>(const Event& a, const Event& b) {
+    return a.time != b.time ? a.time > b.time : a.seq > b.seq;
+}
+
+// Binary min-heap of pending events
+class HeapEventQueue {
+private:
+    std::vector<Event> heap;
+
+public:
+    bool empty() const { return heap.empty(); }
+    size_t size() const { return heap.size(); }
+    void clear() { heap.clear(); }
+
+    void push(const Event& ev) {
+        heap.push_back(ev);
+        std::push_heap(heap.begin(), heap.end(), std::greater<Event>());
+    }
+
+    Event pop() {
+        std::pop_heap(heap.begin(), heap.end(), std::greater<Event>());
+        Event ev = heap.back();
+        heap.pop_back();
+        return ev;
+    }
+};
+
+// Hierarchical timing wheel with amortized O(1) push and pop.
+// Time is cut into 1024 ns ticks. An event lives on the level named by the
+// highest 6-bit digit in which its tick differs from the current tick, so a
+// level-0 bucket holds a single tick and higher buckets cascade down as the
+// clock reaches them. Events in the current tick are kept sorted in a small
+// ready list, which preserves the exact (time, seq) order of the heap.
+// Events must never be pushed earlier than the last popped event.
+class TimingWheelEventQueue {
+private:
+    static constexpr int tickShift = 10;
+    static constexpr int levelBits = 6;
+    static constexpr int levels = 6;
+    static constexpr int bucketsPerLevel = 1 << levelBits;
+
+    std::vector<Event> buckets[levels][bucketsPerLevel];
+    uint64_t occupied[levels];
+    std::vector<Event> ready;
+    size_t readyHead;
+    std::vector<Event> overflow;   // beyond the top level (~19.5 simulated hours)
+    std::vector<Event> cascade;    // scratch for a bucket being redistributed
+    int64_t currentTick;
+    size_t count;
+
+    static bool before(const Event& a, const Event& b) { return b > a; }
+
+    static uint64_t digitsAbove(uint64_t mask, int digit) {
+        return digit == bucketsPerLevel - 1 ? 0 : mask & (~0ULL << (digit + 1));
+    }
+
+    void place(const Event& ev) {
+        int64_t tick = ev.time >> tickShift;
+        if (tick == currentTick) {
+            ready.insert(std::upper_bound(ready.begin() + readyHead, ready.end(), ev, before), ev);
+            return;
+        }
+        int level = (63 - __builtin_clzll(static_cast<uint64_t>(tick ^ currentTick))) / levelBits;
+        if (level >= levels) {
+            overflow.push_back(ev);
+            return;
+        }
+        int idx = static_cast<int>((tick >> (level * levelBits)) & (bucketsPerLevel - 1));
+        buckets[level][idx].push_back(ev);
+        occupied[level] |= 1ULL << idx;
+    }
+
+    // Moves the clock to the next occupied tick and fills the ready list
+    void advance() {
+        ready.clear();
+        readyHead = 0;
+        while (ready.empty()) {
+            int level = 0;
+            uint64_t next = 0;
+            for (; level < levels; ++level) {
+                int digit = static_cast<int>((currentTick >> (level * levelBits)) & (bucketsPerLevel - 1));
+                next = digitsAbove(occupied[level], digit);
+                if (next) break;
+            }
+
+            if (level == levels) {
+                // Wheel exhausted: restart it at the earliest far-future event.
+                // Buffers only change hands here, so drained buckets keep
+                // their capacity and a steady state allocates nothing.
+                cascade.swap(overflow);
+                currentTick = std::min_element(cascade.begin(), cascade.end(), before)->time >> tickShift;
+            } else {
+                int idx = __builtin_ctzll(next);
+                int shift = level * levelBits;
+                currentTick = ((currentTick >> (shift + levelBits)) << (shift + levelBits)) |
+                              (static_cast<int64_t>(idx) << shift);
+                occupied[level] &= ~(1ULL << idx);
+                if (level == 0) {
+                    ready.swap(buckets[0][idx]);
+                    std::sort(ready.begin(), ready.end(), before);
+                    break;
+                }
+                cascade.swap(buckets[level][idx]);
+            }
+            for (const Event& ev : cascade) place(ev);
+            cascade.clear();
+        }
+    }
+
+public:
+    TimingWheelEventQueue() { clear(); }
+
+    bool empty() const { return count == 0; }
+    size_t size() const { return count; }
+
+    void clear() {
+        for (int l = 0; l < levels; ++l) {
+            for (auto& bucket : buckets[l]) bucket.clear();
+            occupied[l] = 0;
+        }
+        ready.clear();
+        readyHead = 0;
+        overflow.clear();
+        currentTick = 0;
+        count = 0;
+    }
+
+    void push(const Event& ev) {
+        place(ev);
+        ++count;
+    }
+
+    Event pop() {
+        if (readyHead == ready.size()) advance();
+        --count;
+        return ready[readyHead++];
+    }
+};
+
+// Pending-event queue implementations the scheduler can run on
+enum class QueueBackend { BinaryHeap, TimingWheel };
+
+inline const char* queueBackendName(QueueBackend backend) {
+    return backend == QueueBackend::TimingWheel ? "timing-wheel" : "binary-heap";
+}
+
+// Discrete-event scheduler. The simulated clock jumps from one event to the
+// next; the handler passed to run() decides what each event type means.
+class EventScheduler {
+private:
+    QueueBackend backend;
+    HeapEventQueue heap;
+    TimingWheelEventQueue wheel;
+    SimTime clock;
+    uint64_t nextSeq;
+    uint64_t processed;
+    uint64_t stale;
+    std::vector<uint32_t> generations;   // current generation per target
+    double wallSeconds;
+    bool stopped;
+
+    static uint32_t nextGeneration(uint32_t generation) {
+        uint32_t next = (generation + 1) & 0xFFFFFF;
+        return next == 0 ? 1 : next;
+    }
+
+    void push(const Event& ev) {
+        if (backend == QueueBackend::TimingWheel) {
+            wheel.push(ev);
+        } else {
+            heap.push(ev);
+        }
+    }
+
+    template <class Queue, class Handler>
+    void dispatch(Queue& queue, Handler& handler) {
+        stopped = false;
+        while (!stopped && !queue.empty()) {
+            Event ev = queue.pop();
+            if (ev.generation != 0) {
+                uint32_t& current = generations[ev.target];
+                if (ev.generation != current) {
+                    ++stale;
+                    continue;
+                }
+                current = nextGeneration(current);   // fired: handle no longer pending
+            }
+            clock = ev.time;
+            ++processed;
+            handler.handleEvent(ev);
+        }
+    }
+
+public:
+    explicit EventScheduler(QueueBackend backend = QueueBackend::BinaryHeap) : backend(backend) { reset(); }
+
+    // Switching backends drops any pending events
+    void setBackend(QueueBackend newBackend) {
+        backend = newBackend;
+        reset();
+    }
+    QueueBackend getBackend() const { return backend; }
+
+    void reset() {
+        heap.clear();
+        wheel.clear();
+        clock = 0;
+        nextSeq = 0;
+        processed = 0;
+        stale = 0;
+        std::fill(generations.begin(), generations.end(), 1);
+        wallSeconds = 0;
+        stopped = false;
+    }
+
+    SimTime now() const { return clock; }
+    size_t pending() const { return backend == QueueBackend::TimingWheel ? wheel.size() : heap.size(); }
+
+    void scheduleAt(SimTime when, uint8_t type, int32_t target) {
+        push(Event{when, nextSeq++, target, type, 0});
+    }
+
+    void schedule(SimTime delay, uint8_t type, int32_t target) {
+        scheduleAt(clock + delay, type, target);
+    }
+
+    // Targets 0..n-1 may own cancellable events
+    void setCancellableTargets(size_t n) { generations.assign(n, 1); }
+
+    EventHandle scheduleCancellableAt(SimTime when, uint8_t type, int32_t target) {
+        uint32_t generation = generations[target];
+        push(Event{when, nextSeq++, target, type, generation});
+        return EventHandle{target, generation};
+    }
+
+    // O(1): the queued event is only dropped when it reaches the front.
+    // Cancelling an event that already fired or was cancelled is a no-op.
+    void cancel(const EventHandle& handle) {
+        if (isPending(handle)) {
+            generations[handle.target] = nextGeneration(handle.generation);
+        }
+    }
+
+    bool isPending(const EventHandle& handle) const {
+        return handle.target >= 0 && generations[handle.target] == handle.generation;
+    }
+
+    void stop() { stopped = true; }
+
+    // Dispatches events to handler.handleEvent(const Event&) until the queue
+    // drains or stop() is called.
+    template <class Handler>
+    void run(Handler& handler) {
+        auto start = std::chrono::steady_clock::now();
+        if (backend == QueueBackend::TimingWheel) {
+            dispatch(wheel, handler);
+        } else {
+            dispatch(heap, handler);
+        }
+        wallSeconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    }
+
+    uint64_t eventsProcessed() const { return processed; }
+    uint64_t stalePops() const { return stale; }
+    double elapsedWallSeconds() const { return wallSeconds; }
+    double eventsPerSecond() const { return wallSeconds > 0 ? processed / wallSeconds : 0; }
+};
+
+#endif
@@ -0,0 +1,197 @@
+#ifndef STATION_TABLE_H
+#define STATION_TABLE_H
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "instrumentation.h"
+#include "rng.h"
+#include "sim_engine.h"
+
+// Structure-of-arrays state for WiFi 4/5 stations. Every field lives in its
+// own contiguous array, so a pass over one field (the backoff counters, the
+// queue heads) streams through memory instead of striding over whole
+// station objects. Stations are numbered in the order they are added, and
+// station i draws from RNG stream i under the table's key.
+// The table takes 23 bytes and one bit per station. A WiFi 4 access point
+// adds 4 bytes per station for its contender heap (event-driven runs) or
+// its expired list (slotted runs), so a station costs about 27 bytes either
+// way; bench.exe measures WiFi4AccessPoint::stationMemoryBytes() at 1M
+// stations and fails above 32.
+class StationTable {
+private:
+    RngKey key;
+    std::vector<uint16_t> backoffInterval;   // slots drawn for the current countdown
+                                             // (slots left, when counted down in place)
+    std::vector<uint8_t> collisionCount;
+    std::vector<uint64_t> waitingForAccess;  // bitmap: sits out the next opportunity
+    std::vector<uint32_t> drawIndex;         // position in each station's stream
+    std::vector<SimTime> queuedSince;        // when the head-of-line packet was queued
+    std::vector<uint32_t> packetsLeft;
+    std::vector<uint32_t> backoffTarget;     // idle slot at which the countdown ends, from targetEpoch
+    uint64_t targetEpoch;
+
+    // Moves the epoch of the backoff targets up to `epoch`. Targets below
+    // it belong to stations that are not contending and become 0.
+    void rebaseTargets(uint64_t epoch) {
+        for (uint32_t& target : backoffTarget) {
+            uint64_t slot = targetEpoch + target;
+            target = slot > epoch ? static_cast<uint32_t>(slot - epoch) : 0;
+        }
+        targetEpoch = epoch;
+    }
+
+    // Index of station i's next draw, moved past it
+    uint32_t takeDraw(size_t i) {
+        uint32_t draw = checkedDrawIndex(drawIndex[i]);
+        drawIndex[i] = draw + 1;
+        return draw;
+    }
+
+public:
+    StationTable() : targetEpoch(0) {}
+
+    size_t size() const { return backoffInterval.size(); }
+
+    void setRandomKey(const RngKey& newKey) { key = newKey; }
+    const RngKey& getRandomKey() const { return key; }
+
+    void clear() {
+        backoffInterval.clear();
+        collisionCount.clear();
+        waitingForAccess.clear();
+        drawIndex.clear();
+        queuedSince.clear();
+        packetsLeft.clear();
+        backoffTarget.clear();
+        targetEpoch = 0;
+    }
+
+    void reserve(size_t n) {
+        backoffInterval.reserve(n);
+        collisionCount.reserve(n);
+        waitingForAccess.reserve((n + 63) / 64);
+        drawIndex.reserve(n);
+        queuedSince.reserve(n);
+        packetsLeft.reserve(n);
+        backoffTarget.reserve(n);
+    }
+
+    // Appends a station and returns its index. drawsUsed continues the
+    // station's stream where its previous owner left off.
+    size_t add(int collisions, uint16_t backoff, uint32_t drawsUsed, bool waiting) {
+        size_t i = size();
+        backoffInterval.push_back(backoff);
+        collisionCount.push_back(static_cast<uint8_t>(collisions < 255 ? collisions : 255));
+        if (i % 64 == 0) waitingForAccess.push_back(0);
+        drawIndex.push_back(drawsUsed);
+        queuedSince.push_back(0);
+        packetsLeft.push_back(0);
+        backoffTarget.push_back(0);
+        setWaiting(i, waiting);
+        return i;
+    }
+
+    // Gives every station `packets` frames, the first one queued at t = 0
+    void resetQueues(uint32_t packets) {
+        std::fill(queuedSince.begin(), queuedSince.end(), 0);
+        std::fill(packetsLeft.begin(), packetsLeft.end(), packets);
+        std::fill(backoffTarget.begin(), backoffTarget.end(), 0);
+        targetEpoch = 0;
+    }
+
+    size_t memoryBytes() const {
+        return backoffInterval.capacity() * sizeof(uint16_t) + collisionCount.capacity() * sizeof(uint8_t) +
+               waitingForAccess.capacity() * sizeof(uint64_t) + drawIndex.capacity() * sizeof(uint32_t) +
+               queuedSince.capacity() * sizeof(SimTime) + packetsLeft.capacity() * sizeof(uint32_t) +
+               backoffTarget.capacity() * sizeof(uint32_t);
+    }
+
+    // Raw arrays for streaming kernels
+    uint16_t* backoffData() { return backoffInterval.data(); }
+    uint8_t* collisionData() { return collisionCount.data(); }
+    uint64_t* waitingData() { return waitingForAccess.data(); }
+    uint32_t* drawIndexData() { return drawIndex.data(); }
+
+    uint16_t getBackoffInterval(size_t i) const { return backoffInterval[i]; }
+    void setBackoffInterval(size_t i, uint16_t slots) { backoffInterval[i] = slots; }
+    int getCollisionCount(size_t i) const { return collisionCount[i]; }
+
+    bool isWaiting(size_t i) const { return (waitingForAccess[i / 64] >> (i % 64)) & 1; }
+    void setWaiting(size_t i, bool waiting) {
+        uint64_t bit = 1ULL << (i % 64);
+        waitingForAccess[i / 64] = waiting ? (waitingForAccess[i / 64] | bit) : (waitingForAccess[i / 64] & ~bit);
+    }
+
+    SimTime getQueuedSince(size_t i) const { return queuedSince[i]; }
+    void setQueuedSince(size_t i, SimTime t) { queuedSince[i] = t; }
+
+    uint32_t getPacketsLeft(size_t i) const { return packetsLeft[i]; }
+    // Retires the head-of-line packet; returns how many are left
+    uint32_t completePacket(size_t i) { return --packetsLeft[i]; }
+    // Queues one more packet (replayed traffic); returns how many are queued
+    uint32_t addPacket(size_t i) { return ++packetsLeft[i]; }
+
+    uint64_t getBackoffTarget(size_t i) const { return targetEpoch + backoffTarget[i]; }
+
+    // A new target is at most 2^16 slots past the current slot and every
+    // pending one lies between the two, so when the new one does not fit in
+    // 32 bits the epoch moves up to 2^16 slots below it
+    void setBackoffTarget(size_t i, uint64_t slot) {
+        if (slot - targetEpoch > UINT32_MAX) rebaseTargets(slot - UINT16_MAX);
+        backoffTarget[i] = static_cast<uint32_t>(slot - targetEpoch);
+    }
+
+    // Contender order: true if station a's countdown ends after station b's,
+    // ties broken by index
+    bool expiresAfter(size_t a, size_t b) const {
+        return backoffTarget[a] != backoffTarget[b] ? backoffTarget[a] > backoffTarget[b] : a > b;
+    }
+
+    // Contention window after c collisions: 21 slots doubling up to 450
+    static uint32_t contentionWindow(int collisions) {
+        return collisions >= 5 ? 450u : std::min(21u << collisions, 450u);
+    }
+
+    uint32_t nextDraw(size_t i) { return counterDraw(key, static_cast<uint32_t>(i), takeDraw(i)); }
+
+    void applyBackoffDraw(size_t i, uint32_t draw) {
+        countHotPath(HotCounter::BackoffRedraws);
+        backoffInterval[i] = static_cast<uint16_t>(scaleDraw(draw, contentionWindow(collisionCount[i])) + 1);
+    }
+
+    void resetBackoffInterval(size_t i) { applyBackoffDraw(i, nextDraw(i)); }
+
+    // Batched form of resetBackoffInterval(), into an RngBatch or LaneRngBatch
+    // that uses the table's key
+    template <class Batch>
+    size_t reserveBackoffDraw(size_t i, Batch& batch) {
+        return batch.request(static_cast<uint32_t>(i), takeDraw(i));
+    }
+
+    void widenContentionWindow(size_t i) {
+        if (collisionCount[i] < 255) collisionCount[i]++;
+    }
+
+    void registerSuccess(size_t i) { collisionCount[i] = 0; }
+
+    // Per-attempt loss model (see WiFiUser::attemptToTransmit)
+    bool attemptToTransmit(size_t i, double congestionFactor) {
+        if (isWaiting(i)) {
+            setWaiting(i, false);
+            return false;
+        }
+        if (!(scaleDraw(nextDraw(i), 150) < congestionFactor * 100)) {
+            collisionCount[i] = 0;
+            return true;
+        }
+        widenContentionWindow(i);
+        resetBackoffInterval(i);
+        setWaiting(i, true);
+        return false;
+    }
+};
+
+#endif
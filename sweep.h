@@ -0,0 +1,121 @@
+#ifndef SWEEP_H
+#define SWEEP_H
+
+#include <cstdint>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+// One cell of a sweep
+struct Scenario {
+    int generation;   // 4, 5 or 6
+    int clients;
+    int packets;
+    int mcs;          // modulation and coding scheme index
+    uint64_t seed;
+};
+
+// Values of one sweep axis: comma-separated numbers and inclusive ranges
+// "first:last" or "first:last:step", e.g. "1,10:100:10,1000".
+inline std::vector<int64_t> parseValueList(const std::string& text) {
+    std::vector<int64_t> values;
+    std::istringstream items(text);
+    for (std::string item; std::getline(items, item, ',');) {
+        std::vector<int64_t> bounds;
+        std::istringstream fields(item);
+        for (std::string field; std::getline(fields, field, ':');) {
+            std::istringstream number(field);
+            int64_t v;
+            if (!(number >> v) || !(number >> std::ws).eof()) {
+                bounds.clear();
+                break;
+            }
+            bounds.push_back(v);
+        }
+        if (bounds.empty() || bounds.size() > 3) {
+            throw std::invalid_argument("bad value '" + item + "' (expected N, FIRST:LAST or FIRST:LAST:STEP)");
+        }
+        int64_t first = bounds[0];
+        int64_t last = bounds.size() > 1 ? bounds[1] : first;
+        int64_t step = bounds.size() > 2 ? bounds[2] : 1;
+        if (step <= 0 || last < first) {
+            throw std::invalid_argument("bad range '" + item + "'");
+        }
+        for (int64_t v = first; v <= last; v += step) {
+            values.push_back(v);
+        }
+    }
+    if (values.empty()) {
+        throw std::invalid_argument("no values in '" + text + "'");
+    }
+    return values;
+}
+
+// All of `text` as the value of command-line option `flag`; throws
+// invalid_argument if it is not a number or `valid` rejects it
+template <class T, class Valid>
+T parseOptionValue(const std::string& flag, const std::string& text, Valid valid, const char* expected) {
+    std::istringstream in(text);
+    T value;
+    bool negative = std::is_unsigned<T>::value && text.find('-') != std::string::npos;
+    if (negative || !(in >> value) || !(in >> std::ws).eof() || !valid(value)) {
+        throw std::invalid_argument("bad value '" + text + "' for " + flag + " (expected " + expected + ")");
+    }
+    return value;
+}
+
+// A Cartesian product over generation, client count, packet count, MCS and
+// seed. expand() lists the scenarios with the generation varying slowest
+// and the seed fastest, so the order of the results depends only on the
+// spec.
+struct SweepSpec {
+    std::vector<int64_t> generations;
+    std::vector<int64_t> clients;
+    std::vector<int64_t> packets;
+    std::vector<int64_t> mcs;
+    std::vector<int64_t> seeds;
+
+    // Sets one axis from "name=values"; the names are generation, clients,
+    // packets, mcs and seed
+    void setAxis(const std::string& assignment) {
+        size_t eq = assignment.find('=');
+        std::string name = assignment.substr(0, eq);
+        if (eq == std::string::npos) {
+            throw std::invalid_argument("expected name=values, got '" + assignment + "'");
+        }
+        std::vector<int64_t> values = parseValueList(assignment.substr(eq + 1));
+        if (name == "generation") generations = values;
+        else if (name == "clients") clients = values;
+        else if (name == "packets") packets = values;
+        else if (name == "mcs") mcs = values;
+        else if (name == "seed") seeds = values;
+        else throw std::invalid_argument("unknown sweep axis '" + name + "'");
+    }
+
+    // Whitespace-separated assignments, e.g.
+    // "generation=4,5 clients=1,10,100 packets=1000 mcs=0:9 seed=1:4";
+    // axes not named keep their current values
+    void parse(const std::string& spec) {
+        std::istringstream assignments(spec);
+        for (std::string assignment; assignments >> assignment;) {
+            setAxis(assignment);
+        }
+    }
+
+    size_t size() const { return generations.size() * clients.size() * packets.size() * mcs.size() * seeds.size(); }
+
+    void expand(std::vector<Scenario>& scenarios) const {
+        for (int64_t g : generations)
+            for (int64_t c : clients)
+                for (int64_t p : packets)
+                    for (int64_t m : mcs)
+                        for (int64_t s : seeds) {
+                            scenarios.push_back(Scenario{static_cast<int>(g), static_cast<int>(c), static_cast<int>(p),
+                                                         static_cast<int>(m), static_cast<uint64_t>(s)});
+                        }
+    }
+};
+
+#endif
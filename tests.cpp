@@ -0,0 +1,568 @@
+#include <algorithm>
+#include <iostream>
+#include <cmath>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "access_points.h"
+#include "contention_kernel.h"
+#include "output_analysis.h"
+#include "quantile_sketch.h"
+#include "scenario_runner.h"
+#include "sweep.h"
+#include "trace_codec.h"
+
+using namespace std;
+
+// Checks of the statistics against values computed by hand or taken from
+// published tables, and of the simulator's exactness claims: paths that
+// promise identical results are run side by side and compared bit for bit.
+// Prints every failure and exits with 1 if there was one.
+
+static int failures = 0;
+
+static void checkNear(const string& what, double actual, double expected, double tolerance) {
+    if (fabs(actual - expected) <= tolerance) return;
+    cerr << "FAIL " << what << ": got " << actual << ", expected " << expected << " +- " << tolerance << "\n";
+    failures++;
+}
+
+static void check(const string& what, bool ok) {
+    if (ok) return;
+    cerr << "FAIL " << what << "\n";
+    failures++;
+}
+
+// Every SIMD level the CPU has runs the same slots as scalar code
+static const SimdLevel simdLevels[] = {SimdLevel::Scalar, SimdLevel::AVX2, SimdLevel::AVX512};
+
+// Two-sided critical values from the usual t table (3 decimals)
+static void testStudentT() {
+    const struct {
+        double confidence;
+        uint64_t df;
+        double t;
+    } table[] = {
+        {0.95, 1, 12.706}, {0.95, 2, 4.303}, {0.95, 3, 3.182}, {0.95, 4, 2.776}, {0.95, 5, 2.571},
+        {0.95, 10, 2.228}, {0.95, 20, 2.086}, {0.95, 30, 2.042}, {0.95, 40, 2.021}, {0.95, 120, 1.980},
+        {0.99, 1, 63.657}, {0.99, 2, 9.925}, {0.99, 5, 4.032}, {0.99, 30, 2.750},
+        {0.90, 1, 6.314}, {0.90, 3, 2.353}, {0.90, 30, 1.697},
+    };
+    for (const auto& row : table) {
+        checkNear("t(" + to_string(row.confidence) + ", " + to_string(row.df) + ")",
+                  studentTCritical(row.confidence, row.df), row.t, 0.0006);
+    }
+}
+
+// Five batches of one observation, 1..5: mean 3, standard deviation
+// sqrt(2.5), so the 95% half-width is t(0.95, 4) * sqrt(2.5 / 5) with the
+// exact t(0.95, 4) = 2.776445
+static void testBatchMeansInterval() {
+    BatchMeans series(1);
+    for (int x = 1; x <= 5; ++x) series.add(x);
+    checkNear("batch count", static_cast<double>(series.batchCount()), 5, 0);
+    checkNear("batch means mean", series.mean(), 3, 1e-12);
+    checkNear("batch means half-width", series.halfWidth(0.95), 2.776445 * sqrt(0.5), 1e-5);
+
+    // Three batches of two: means 1.5, 3.5 and 5.5, standard deviation 2,
+    // so the half-width is t(0.99, 2) * 2 / sqrt(3) with t(0.99, 2) = 9.924843
+    BatchMeans pairs(2);
+    for (int x = 1; x <= 6; ++x) pairs.add(x);
+    checkNear("paired batch half-width", pairs.halfWidth(0.99), 9.924843 * 2 / sqrt(3.0), 1e-5);
+
+    // Prepending held-back observations gives the series they would have
+    // started
+    BatchMeans whole(2), late(2);
+    for (int x = 1; x <= 8; ++x) whole.add(x * x);
+    for (int x = 5; x <= 8; ++x) late.add(x * x);
+    late.prepend(4, [](size_t i) { return static_cast<double>((i + 1) * (i + 1)); });
+    checkNear("prepended mean", late.mean(), whole.mean(), 1e-12);
+    checkNear("prepended half-width", late.halfWidth(0.95), whole.halfWidth(0.95), 1e-12);
+}
+
+static void testMannWhitney() {
+    // a beats b in 3 of 12 pairs (3.4 > 2.0, 5.0 > 2.0, 5.0 > 4.2). Of the
+    // C(7, 3) = 35 orderings 1 + 1 + 2 + 3 have U <= 3, so p = 2 * 7 / 35.
+    RankSumTest test = mannWhitneyU({1.1, 3.4, 5.0}, {2.0, 4.2, 6.3, 7.1});
+    checkNear("U, 3 vs 4", test.u, 3, 0);
+    checkNear("exact p, 3 vs 4", test.pValue, 0.4, 1e-12);
+
+    // Complete separation: only 1 of C(10, 5) = 252 orderings on each side
+    test = mannWhitneyU({6, 7, 8, 9, 10}, {1, 2, 3, 4, 5});
+    checkNear("U, separated", test.u, 25, 0);
+    checkNear("exact p, separated", test.pValue, 2.0 / 252, 1e-12);
+
+    // A tie counts 1/2 and sends the test to the normal approximation:
+    // variance 2 * 2 / 12 * (5 - 6 / 12) = 1.5, z = (|0.5 - 2| - 0.5) / sqrt(1.5)
+    test = mannWhitneyU({1, 2}, {2, 3});
+    checkNear("U with a tie", test.u, 0.5, 0);
+    checkNear("approximate p with a tie", test.pValue, erfc(1 / sqrt(1.5) / sqrt(2.0)), 1e-12);
+}
+
+// The countdown kernel at each level gives the scalar kernel's expiries
+// and counters, slot after slot. Idle stations (0), expiries in the vector
+// body and in the scalar tail, and several per step are all covered.
+static void testCountdownLevels() {
+    const size_t n = 1000 + 13;   // not a multiple of any vector width
+    vector<uint16_t> initial(n);
+    for (size_t i = 0; i < n; ++i) initial[i] = i % 11 == 0 ? 0 : static_cast<uint16_t>(i * 37 % 23 + 1);
+    const SimdLevel saved = simdLevelLimit();
+    vector<uint32_t> reference;
+    for (SimdLevel level : simdLevels) {
+        simdLevelLimit() = level;
+        if (activeSimdLevel() != level) continue;
+        vector<uint16_t> counters = initial;
+        vector<uint32_t> expired(n), seen;
+        for (uint32_t slot = 0; slot < 200; ++slot) {
+            size_t count = countdownSlot(counters.data(), n, expired.data());
+            seen.push_back(static_cast<uint32_t>(count));
+            for (size_t k = 0; k < count; ++k) {
+                seen.push_back(expired[k]);
+                counters[expired[k]] = static_cast<uint16_t>((expired[k] + slot) % 19 + 1);
+            }
+        }
+        seen.insert(seen.end(), counters.begin(), counters.end());
+        if (level == SimdLevel::Scalar) reference = seen;
+        check(string("countdown slots, ") + simdLevelName(level) + " vs scalar", seen == reference);
+    }
+    simdLevelLimit() = saved;
+}
+
+// Delays from the same instant to past the wheel's top level (about 2^46
+// ns), so events tie, share a tick, cascade from every level and overflow
+static SimTime randomDelay(mt19937_64& gen) {
+    const int shift = static_cast<int>(gen() % 48);
+    if (shift == 0) return 0;
+    return static_cast<SimTime>((1ULL << (shift - 1)) + gen() % (1ULL << (shift - 1)));
+}
+
+// Pushes and pops interleaved at random, a few hundred events pending: the
+// heap and the timing wheel pop the same (time, seq) order
+static void testEventQueues() {
+    HeapEventQueue heap;
+    TimingWheelEventQueue wheel;
+    mt19937_64 gen(5);
+    uint64_t seq = 0;
+    SimTime now = 0;
+    bool same = true;
+    for (int round = 0; round < 50000; ++round) {
+        for (uint64_t pushes = gen() % 4; pushes > 0; --pushes) {
+            Event ev{now + randomDelay(gen), seq++, 0, 0, 0};
+            heap.push(ev);
+            wheel.push(ev);
+        }
+        while (!heap.empty() && gen() % 5 < 3) {
+            Event a = heap.pop(), b = wheel.pop();
+            same = same && a.time == b.time && a.seq == b.seq;
+            now = a.time;
+        }
+        same = same && heap.size() == wheel.size();
+    }
+    while (!heap.empty()) {
+        Event a = heap.pop(), b = wheel.pop();
+        same = same && a.time == b.time && a.seq == b.seq;
+    }
+    check("heap vs timing wheel pop order", same && wheel.empty());
+}
+
+// Schedules, reschedules and cancels events from its handler, logging
+// every event it is handed. Events for target -1 always schedule their
+// successor, so the queue never runs dry.
+struct SchedulerExerciser {
+    EventScheduler scheduler;
+    mt19937_64 gen;
+    EventHandle handles[8];
+    vector<uint64_t> log;
+    int remaining;
+
+    explicit SchedulerExerciser(QueueBackend backend) : scheduler(backend), gen(9), remaining(100000) {
+        scheduler.setCancellableTargets(8);
+        scheduler.scheduleAt(0, 0, -1);
+    }
+
+    void handleEvent(const Event& ev) {
+        log.insert(log.end(), {static_cast<uint64_t>(ev.time), ev.seq, static_cast<uint64_t>(ev.target), ev.type});
+        if (--remaining == 0) {
+            scheduler.stop();
+            return;
+        }
+        if (ev.target < 0) scheduler.schedule(randomDelay(gen), 0, -1);
+        for (uint64_t k = gen() % 4; k > 0; --k) {
+            int32_t target = static_cast<int32_t>(gen() % 8);
+            switch (gen() % 3) {
+            case 0:
+                scheduler.schedule(randomDelay(gen), 0, target);
+                break;
+            case 1:
+                scheduler.cancel(handles[target]);
+                handles[target] = scheduler.scheduleCancellableAt(scheduler.now() + randomDelay(gen), 1, target);
+                break;
+            default:
+                scheduler.cancel(handles[target]);
+                break;
+            }
+        }
+    }
+};
+
+// Same handler on both backends, with cancelled events dropped lazily at
+// the front of the queue: identical dispatch and the same stale pops
+static void testSchedulerBackends() {
+    SchedulerExerciser heap(QueueBackend::BinaryHeap), wheel(QueueBackend::TimingWheel);
+    heap.scheduler.run(heap);
+    wheel.scheduler.run(wheel);
+    check("scheduler dispatch, heap vs timing wheel", heap.log == wheel.log && heap.remaining == 0);
+    check("stale pops, heap vs timing wheel",
+          heap.scheduler.stalePops() == wheel.scheduler.stalePops() && heap.scheduler.stalePops() > 0);
+}
+
+// counterDrawBatch at each level returns counterDraw's values, under one
+// scenario or one per draw, up to the last draw index a stream allows
+static void testDrawBatchLevels() {
+    const size_t n = 1000 + 13;   // not a multiple of any vector width
+    const uint64_t seed = 0x123456789ABCDEFull;
+    mt19937_64 gen(3);
+    vector<uint32_t> scenarios(n), streams(n), draws(n), expected(n), shared(n);
+    for (size_t i = 0; i < n; ++i) {
+        scenarios[i] = static_cast<uint32_t>(gen());
+        streams[i] = i % 7 == 0 ? accessPointStream : static_cast<uint32_t>(gen() % 100000);
+        draws[i] = i % 5 == 0 ? static_cast<uint32_t>(maxStreamDraws - 1 - gen() % 4) : static_cast<uint32_t>(gen());
+        expected[i] = counterDraw(RngKey{seed, scenarios[i]}, streams[i], draws[i]);
+        shared[i] = counterDraw(RngKey{seed, scenarios[0]}, streams[i], draws[i]);
+    }
+    const SimdLevel saved = simdLevelLimit();
+    for (SimdLevel level : simdLevels) {
+        simdLevelLimit() = level;
+        if (activeSimdLevel() != level) continue;
+        vector<uint32_t> out(n);
+        counterDrawBatch(seed, scenarios.data(), streams.data(), draws.data(), out.data(), n);
+        check(string("draws per scenario, ") + simdLevelName(level) + " vs counterDraw", out == expected);
+        counterDrawBatch(RngKey{seed, scenarios[0]}, streams.data(), draws.data(), out.data(), n);
+        check(string("draws under one key, ") + simdLevelName(level) + " vs counterDraw", out == shared);
+    }
+    simdLevelLimit() = saved;
+}
+
+static bool sameSketch(const QuantileSketch& a, const QuantileSketch& b) {
+    bool same = a.getFirstBin() == b.getFirstBin() && a.getBins() == b.getBins() && a.count() == b.count() &&
+                a.totalNanoseconds() == b.totalNanoseconds() && a.min() == b.min() && a.max() == b.max();
+    for (double q : {0.0, 0.01, 0.25, 0.5, 0.9, 0.99, 0.999, 1.0}) same = same && a.quantile(q) == b.quantile(q);
+    return same;
+}
+
+// Merging is exact: three sketches over different ranges (one with zero
+// latencies) merged in every order, and grouped either way, give the bins
+// and quantiles of one sketch that saw every value. Sketches of different
+// accuracy refuse to merge.
+static void testSketchMerge() {
+    mt19937_64 gen(11);
+    QuantileSketch parts[3], all;
+    for (int p = 0; p < 3; ++p) {
+        for (int i = 0; i < 2000; ++i) {
+            SimTime v = p == 0 && i % 10 == 0 ? 0 : static_cast<SimTime>(gen() % (1000ull << (8 * p)));
+            parts[p].add(v);
+            all.add(v);
+        }
+    }
+    int order[] = {0, 1, 2};
+    do {
+        QuantileSketch merged;
+        for (int p : order) merged.merge(parts[p]);
+        check("merge in order " + to_string(order[0]) + to_string(order[1]) + to_string(order[2]),
+              sameSketch(merged, all));
+    } while (next_permutation(order, order + 3));
+    QuantileSketch left = parts[0], right = parts[1];
+    left.merge(parts[1]);
+    left.merge(parts[2]);
+    right.merge(parts[2]);
+    QuantileSketch grouped = parts[0];
+    grouped.merge(right);
+    check("(a + b) + c equals a + (b + c)", sameSketch(left, grouped));
+
+    QuantileSketch coarse(0.02);
+    coarse.add(1000);
+    bool threw = false;
+    try {
+        all.merge(coarse);
+    } catch (const invalid_argument&) {
+        threw = true;
+    }
+    check("merging sketches of different accuracy throws", threw);
+    check("failed merge leaves the sketch unchanged", all.count() == 6000);
+}
+
+// A station's stream gives its last draw and then throws instead of
+// wrapping its 32-bit index
+static void testStreamLimit() {
+    const RngKey key{5, 77};
+    StationTable table;
+    table.setRandomKey(key);
+    table.add(0, 1, static_cast<uint32_t>(maxStreamDraws - 2), false);
+    check("second to last draw", table.nextDraw(0) == counterDraw(key, 0, maxStreamDraws - 2));
+    RngBatch batch(key);
+    size_t last = table.reserveBackoffDraw(0, batch);
+    batch.generate();
+    check("last draw, batched", batch[last] == counterDraw(key, 0, maxStreamDraws - 1));
+    bool threw = false;
+    try {
+        table.nextDraw(0);
+    } catch (const overflow_error&) {
+        threw = true;
+    }
+    check("draw past the end of a stream throws", threw);
+}
+
+static bool sameRecord(const PacketRecord& a, const PacketRecord& b) {
+    return a.enqueueTime == b.enqueueTime && a.firstAttempt == b.firstAttempt &&
+           a.completionTime == b.completionTime && a.station == b.station && a.size == b.size &&
+           a.retries == b.retries && a.outcome == b.outcome;
+}
+
+// Encoded blocks decode to the records that went in. The records mix
+// station changes and repeats, queueing at the previous completion or
+// later, packets sent once at the predicted access time or not, retry
+// counts past the head byte's escape, drops and size changes; times are
+// multiples of the tick, so they survive it exactly. Blocks are decoded
+// last to first to show that each restarts the predictions.
+static void testTraceCodec() {
+    mt19937_64 gen(19);
+    for (int64_t tick : {1, 1000}) {
+        vector<uint32_t> blockClients;
+        vector<vector<PacketRecord>> blocks;
+        vector<vector<uint8_t>> encoded;
+        TraceEncoder encoder(tick);
+        for (int b = 0; b < 6; ++b) {
+            const uint32_t clients = 1 + gen() % 20;
+            vector<int64_t> lastCompletion(clients, 0);
+            vector<PacketRecord> records(1 + gen() % 400);
+            int64_t now = 0, access = 0;
+            uint32_t station = 0;
+            uint16_t size = 1500;
+            for (PacketRecord& r : records) {
+                if (gen() % 3) station = gen() % clients;
+                if (gen() % 8 == 0) size = static_cast<uint16_t>(64 + gen() % 1500);
+                r.station = station;
+                r.size = size;
+                r.retries = gen() % 2 ? 0 : static_cast<uint8_t>(1 + gen() % 12);
+                r.outcome = r.retries && gen() % 4 == 0 ? PACKET_DROPPED : PACKET_DELIVERED;
+                int64_t queued = gen() % 2 ? lastCompletion[station] : lastCompletion[station] + gen() % 5000;
+                now = max(now, queued) + 1 + gen() % 20000;
+                if (r.retries == 0 && (gen() % 2 || now - access < queued)) access = 1 + gen() % (now - queued);
+                int64_t first = r.retries ? queued + gen() % (now - queued) : now - access;
+                r.enqueueTime = queued * tick;
+                r.firstAttempt = first * tick;
+                r.completionTime = now * tick;
+                lastCompletion[station] = now;
+            }
+            encoder.reset();
+            vector<uint8_t> bytes(records.size() * maxEncodedRecord);
+            uint8_t* out = bytes.data();
+            bool bounded = true;
+            for (const PacketRecord& r : records) {
+                uint8_t* start = out;
+                out = encoder.encode(out, r);
+                bounded = bounded && out - start <= static_cast<ptrdiff_t>(maxEncodedRecord);
+            }
+            check("encoded records fit maxEncodedRecord", bounded);
+            bytes.resize(out - bytes.data());
+            blockClients.push_back(clients);
+            blocks.push_back(records);
+            encoded.push_back(bytes);
+        }
+        TraceDecoder decoder(tick);
+        for (size_t b = blocks.size(); b-- > 0;) {
+            const string block = "tick " + to_string(tick) + " ns, block " + to_string(b);
+            decoder.begin(blockClients[b]);
+            const uint8_t* in = encoded[b].data();
+            const uint8_t* end = in + encoded[b].size();
+            bool same = true;
+            try {
+                for (const PacketRecord& r : blocks[b]) {
+                    PacketRecord decoded;
+                    in = decoder.decode(in, end, decoded);
+                    same = same && sameRecord(decoded, r);
+                }
+            } catch (const invalid_argument& e) {
+                cerr << e.what() << "\n";
+                same = false;
+            }
+            check("decoded records match, " + block, same);
+            check("decoder consumes the whole block, " + block, in == end);
+        }
+    }
+}
+
+static bool sameResult(const SimulationResult& a, const SimulationResult& b) {
+    return a.delivered == b.delivered && a.dropped == b.dropped && a.warmupDiscarded == b.warmupDiscarded &&
+           a.simulatedSeconds == b.simulatedSeconds && a.throughputMbps == b.throughputMbps &&
+           a.meanLatencyMs == b.meanLatencyMs && a.p50LatencyMs == b.p50LatencyMs &&
+           a.p90LatencyMs == b.p90LatencyMs && a.p99LatencyMs == b.p99LatencyMs &&
+           a.p999LatencyMs == b.p999LatencyMs && a.maxLatencyMs == b.maxLatencyMs;
+}
+
+// The event-driven, slotted and lockstep WiFi 4 engines draw the same
+// numbers in the same per-station order, so their results are equal, not
+// just close. 18 replications keep some lockstep lanes busy with a second
+// replication after their first.
+static void testWiFi4Engines() {
+    const int clients = 10, packets = 200, replications = 18;
+    for (uint64_t seed : {1, 2}) {
+        vector<RngKey> keys;
+        for (int r = 0; r < replications; ++r) {
+            keys.push_back(RngKey{seed, replicationScenario(scenarioId(4, clients, packets), static_cast<uint32_t>(r))});
+        }
+        WiFi4LockstepRunner lockstep;
+        lockstep.run(keys, clients, packets);
+        for (int r = 0; r < replications; ++r) {
+            SimulationResult results[2];
+            for (int slotted = 0; slotted < 2; ++slotted) {
+                WiFi4AccessPoint wifi4;
+                wifi4.setRandomKey(keys[r]);
+                for (int i = 0; i < clients; ++i) wifi4.addClient(WiFiUser(i, keys[r]));
+                if (slotted) {
+                    wifi4.simulateSlotted(packets);
+                } else {
+                    wifi4.simulateNetwork(packets);
+                }
+                wifi4.fillResult(results[slotted]);
+            }
+            const string run = "seed " + to_string(seed) + ", replication " + to_string(r);
+            check("delivered packets, " + run, results[0].delivered > 0);
+            check("slotted vs event-driven, " + run, sameResult(results[1], results[0]));
+            check("lockstep vs event-driven, " + run, sameResult(lockstep.getResults()[r], results[0]));
+        }
+    }
+}
+
+template <class Parse>
+static bool throwsInvalid(Parse parse) {
+    try {
+        parse();
+    } catch (const invalid_argument&) {
+        return true;
+    }
+    return false;
+}
+
+static bool sameScenarios(const vector<Scenario>& a, const vector<Scenario>& b) {
+    if (a.size() != b.size()) return false;
+    for (size_t i = 0; i < a.size(); ++i) {
+        if (a[i].generation != b[i].generation || a[i].clients != b[i].clients || a[i].packets != b[i].packets ||
+            a[i].mcs != b[i].mcs || a[i].seed != b[i].seed) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Value lists, --sweep specs and scenario files parse to the scenarios
+// they name, in order, and malformed ones are rejected
+static void testSweepParsing() {
+    check("value list", parseValueList("1,10:30:10,1000") == vector<int64_t>({1, 10, 20, 30, 1000}));
+    check("range without step", parseValueList("5:7") == vector<int64_t>({5, 6, 7}));
+    check("step past the end", parseValueList("3:10:4") == vector<int64_t>({3, 7}));
+    check("single value", parseValueList("-2") == vector<int64_t>({-2}));
+    for (const char* bad : {"", "x", "1,,2", "1:2:3:4", "5:1", "1:5:0", "1:5:-1", "2.5", "1 2"}) {
+        check("value list '" + string(bad) + "' rejected", throwsInvalid([&] { parseValueList(bad); }));
+    }
+
+    SweepSpec sweep;
+    sweep.packets = {100};
+    sweep.parse("generation=4,5 clients=1:3  mcs=0:9:9 seed=7");
+    vector<Scenario> scenarios;
+    sweep.expand(scenarios);
+    check("sweep size", sweep.size() == 12 && scenarios.size() == 12);
+    check("sweep order, generation slowest and seed fastest",
+          sameScenarios(vector<Scenario>(scenarios.begin(), scenarios.begin() + 3),
+                        {{4, 1, 100, 0, 7}, {4, 1, 100, 9, 7}, {4, 2, 100, 0, 7}}) &&
+              sameScenarios({scenarios.back()}, {{5, 3, 100, 9, 7}}));
+    sweep.parse("seed=1,2");
+    check("later assignments replace an axis", sweep.seeds == vector<int64_t>({1, 2}) && sweep.size() == 24);
+    check("unknown axis rejected", throwsInvalid([&] { sweep.parse("client=4"); }));
+    check("assignment without '=' rejected", throwsInvalid([&] { sweep.parse("generation"); }));
+    check("bad axis values rejected", throwsInvalid([&] { sweep.setAxis("mcs=0:x"); }));
+
+    SweepSpec defaults;
+    defaults.clients = {1};
+    defaults.packets = {30};
+    defaults.mcs = {defaultMcs};
+    defaults.seeds = {1};
+    istringstream file("# comment\n"
+                       "\n"
+                       "4 10 100\n"
+                       "5 2 50 7\n"
+                       "6 3 20 8 11   # seed 8, MCS 11\n"
+                       "generation=4 clients=1,2 mcs=0\n");
+    check("scenario file", sameScenarios(readScenarios(file, "s", defaults),
+                                         {{4, 10, 100, defaultMcs, 1}, {5, 2, 50, defaultMcs, 7}, {6, 3, 20, 11, 8},
+                                          {4, 1, 30, 0, 1}, {4, 2, 30, 0, 1}}));
+    for (const char* bad : {"4 10", "4 10 100 1 2 3", "4 ten 100", "7 1 1", "4 0 1", "5 1 1 1 10", "clients=3",
+                            "generation=4 clients=0:2"}) {
+        istringstream in(string("4 1 1\n") + bad + "\n");
+        string message;
+        try {
+            readScenarios(in, "s", defaults);
+        } catch (const invalid_argument& e) {
+            message = e.what();
+        }
+        check("scenario line '" + string(bad) + "' rejected with its line number", message.compare(0, 4, "s:2:") == 0);
+    }
+}
+
+// A sweep gives the same outcomes, replication for replication, on one
+// worker as on four, with the event-driven engine (a task per
+// replication) and with lockstep (a task per group of replications)
+static void testSweepWorkers() {
+    SweepSpec sweep;
+    sweep.parse("generation=4:6 clients=1,5 packets=200 mcs=5 seed=1:2");
+    vector<Scenario> scenarios;
+    sweep.expand(scenarios);
+    for (ContentionEngine engine : {ContentionEngine::EventDriven, ContentionEngine::Lockstep}) {
+        SimulationOptions options;
+        options.contention = engine;
+        options.replications = 3;
+        vector<ScenarioOutcome> outcomes[2];
+        for (int run = 0; run < 2; ++run) {
+            options.threads = run ? 4 : 1;
+            RunnerStats stats;
+            outcomes[run] = runScenarios(scenarios, options, false, stats);
+            check("worker count", stats.threads == options.threads);
+        }
+        const string name = engine == ContentionEngine::Lockstep ? "lockstep" : "event-driven";
+        bool same = outcomes[0].size() == scenarios.size() && outcomes[1].size() == scenarios.size();
+        for (size_t i = 0; same && i < scenarios.size(); ++i) {
+            const vector<SimulationResult>& one = outcomes[0][i].results;
+            const vector<SimulationResult>& four = outcomes[1][i].results;
+            same = one.size() == 3 && four.size() == 3 && sameSketch(outcomes[0][i].latencies, outcomes[1][i].latencies);
+            for (size_t r = 0; same && r < one.size(); ++r) {
+                same = one[r].delivered > 0 && sameResult(one[r], four[r]) &&
+                       one[r].replication == static_cast<int>(r) && four[r].replication == static_cast<int>(r);
+            }
+        }
+        check("1 vs 4 workers, " + name, same);
+    }
+}
+
+int main() {
+    testStudentT();
+    testBatchMeansInterval();
+    testMannWhitney();
+    testSketchMerge();
+    testEventQueues();
+    testSchedulerBackends();
+    testCountdownLevels();
+    testDrawBatchLevels();
+    testStreamLimit();
+    testTraceCodec();
+    testWiFi4Engines();
+    testSweepParsing();
+    testSweepWorkers();
+    if (failures > 0) {
+        cerr << failures << " checks failed\n";
+        return 1;
+    }
+    cout << "All checks passed\n";
+    return 0;
+}
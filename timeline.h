@@ -0,0 +1,165 @@
+#ifndef TIMELINE_H
+#define TIMELINE_H
+
+// Engine-level spans (scenario runs, sweep tasks, RNG refills, statistics
+// merges, trace flushes) for --timeline, written in the Chrome trace event
+// format that chrome://tracing and ui.perfetto.dev open. Each thread appends
+// to its own log, so recording a span takes no lock; the logs stay with the
+// timeline after their thread exits and are written once at the end.
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <iomanip>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+#include "instrumentation.h"
+
+struct TimelineSpan {
+    const char* name;       // string literals only, so a span never allocates
+    const char* category;
+    int64_t startNs;        // since the timeline was enabled
+    int64_t endNs;
+    const char* argNames[3];
+    int64_t args[3];
+};
+
+class Timeline {
+private:
+    struct ThreadLog {
+        int tid;
+        std::string name;
+        std::vector<TimelineSpan> spans;
+    };
+
+    std::atomic<bool> enabled;
+    std::chrono::steady_clock::time_point epoch;
+    std::mutex lock;   // guards `threads` while threads register
+    std::vector<std::unique_ptr<ThreadLog>> threads;
+
+    Timeline() : enabled(false), epoch(std::chrono::steady_clock::now()) {}
+
+    ThreadLog& threadLog() {
+        thread_local ThreadLog* log = nullptr;
+        if (!log) {
+            std::lock_guard<std::mutex> guard(lock);
+            threads.emplace_back(new ThreadLog);
+            log = threads.back().get();
+            log->tid = static_cast<int>(threads.size());
+            log->spans.reserve(4096);
+        }
+        return *log;
+    }
+
+    static void writeMicroseconds(std::ostream& out, int64_t ns) {
+        out << ns / 1000 << '.' << std::setw(3) << std::setfill('0') << ns % 1000 << std::setfill(' ');
+    }
+
+public:
+    static Timeline& instance() {
+        static Timeline timeline;
+        return timeline;
+    }
+
+    // Starts recording; times are counted from here
+    void enable() {
+        epoch = std::chrono::steady_clock::now();
+        enabled.store(true, std::memory_order_release);
+    }
+
+    bool isEnabled() const { return enabled.load(std::memory_order_relaxed); }
+
+    int64_t now() const {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - epoch).count();
+    }
+
+    void record(const TimelineSpan& span) { threadLog().spans.push_back(span); }
+
+    // Names the calling thread's track (the first name sticks)
+    void nameThread(const char* prefix, int index = -1) {
+        if (!isEnabled()) return;
+        ThreadLog& log = threadLog();
+        if (log.name.empty()) log.name = index >= 0 ? prefix + (" " + std::to_string(index)) : prefix;
+    }
+
+    // Every span so far as a Chrome trace, one track per thread. Only to
+    // be called once the recording threads have finished.
+    void write(std::ostream& out) {
+        std::lock_guard<std::mutex> guard(lock);
+        out << "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[\n";
+        bool first = true;
+        for (const auto& thread : threads) {
+            if (!thread->name.empty()) {
+                out << (first ? "" : ",\n") << "{\"ph\":\"M\",\"name\":\"thread_name\",\"pid\":1,\"tid\":" << thread->tid
+                    << ",\"args\":{\"name\":\"" << thread->name << "\"}}";
+                first = false;
+            }
+            for (const TimelineSpan& span : thread->spans) {
+                out << (first ? "" : ",\n") << "{\"ph\":\"X\",\"name\":\"" << span.name << "\",\"cat\":\""
+                    << span.category << "\",\"pid\":1,\"tid\":" << thread->tid << ",\"ts\":";
+                writeMicroseconds(out, span.startNs);
+                out << ",\"dur\":";
+                writeMicroseconds(out, span.endNs - span.startNs);
+                out << ",\"args\":{";
+                for (int a = 0; a < 3 && span.argNames[a]; ++a) {
+                    out << (a ? "," : "") << '"' << span.argNames[a] << "\":" << span.args[a];
+                }
+                out << "}}";
+                first = false;
+            }
+        }
+        out << "\n]}\n";
+    }
+};
+
+// Records its lifetime as a span when the timeline is on; otherwise costs
+// one relaxed load. arg() attaches up to three integers.
+class TimelineScope {
+private:
+    TimelineSpan span;
+    bool active;
+
+public:
+    TimelineScope(const char* name, const char* category) : span(), active(Timeline::instance().isEnabled()) {
+        if (!active) return;
+        span.name = name;
+        span.category = category;
+        span.startNs = Timeline::instance().now();
+    }
+
+    ~TimelineScope() {
+        if (!active) return;
+        span.endNs = Timeline::instance().now();
+        Timeline::instance().record(span);
+    }
+
+    TimelineScope(const TimelineScope&) = delete;
+    TimelineScope& operator=(const TimelineScope&) = delete;
+
+    TimelineScope& arg(const char* name, int64_t value) {
+        for (int a = 0; a < 3; ++a) {
+            if (!span.argNames[a]) {
+                span.argNames[a] = name;
+                span.args[a] = value;
+                break;
+            }
+        }
+        return *this;
+    }
+};
+
+struct NoTimelineScope {
+    NoTimelineScope(const char*, const char*) {}
+    NoTimelineScope& arg(const char*, int64_t) { return *this; }
+};
+
+// Spans inside the event loops (RNG refills) are kept only by instrumented
+// builds, like the hot-path counters
+using HotTimelineScope = std::conditional_t<instrumentationEnabled, TimelineScope, NoTimelineScope>;
+
+#endif
@@ -0,0 +1,213 @@
+#include <iostream>
+#include <iomanip>
+#include <vector>
+#include <map>
+#include <tuple>
+#include <string>
+#include <chrono>
+#include <thread>
+#include <algorithm>
+#include <stdexcept>
+
+#include "quantile_sketch.h"
+#include "sim_engine.h"
+#include "sweep.h"
+#include "trace_reader.h"
+#include "work_stealing.h"
+
+using namespace std;
+
+// Offline analysis of a --trace file: throughput, latency percentiles and a
+// per-station breakdown of every run in it, without re-running the
+// simulation. The file is memory-mapped and cut into pieces that a
+// work-stealing pool scans in parallel; each worker keeps its own partial
+// results, merged in worker order at the end. Counts and sums are integers
+// and sketches merge exactly, so the report does not depend on the thread
+// count.
+
+// Pieces small enough to balance the threads, large enough that the
+// per-piece lookup of the run is negligible
+constexpr size_t recordsPerPiece = 1 << 16;
+
+// Runs sort in sweep order: generation, clients, packets, MCS, seed,
+// replication
+typedef tuple<uint16_t, uint32_t, uint32_t, uint16_t, uint64_t, uint32_t> RunKey;
+
+RunKey runKey(const TraceBlockHeader& run) {
+    return RunKey(run.generation, run.clients, run.packets, run.mcs, run.seed, run.replication);
+}
+
+struct StationStats {
+    uint64_t delivered = 0;
+    uint64_t dropped = 0;
+    uint64_t retries = 0;
+    int64_t latencySum = 0;   // ns, delivered packets
+    SimTime maxLatency = 0;
+
+    void merge(const StationStats& other) {
+        delivered += other.delivered;
+        dropped += other.dropped;
+        retries += other.retries;
+        latencySum += other.latencySum;
+        maxLatency = std::max(maxLatency, other.maxLatency);
+    }
+};
+
+// Everything known about one run, from all or part of its records
+struct RunAnalysis {
+    uint64_t delivered = 0;
+    uint64_t dropped = 0;
+    uint64_t retries = 0;
+    uint64_t deliveredBytes = 0;
+    SimTime end = 0;            // last completion
+    QuantileSketch latency;     // enqueue to ACK, delivered packets
+    QuantileSketch access;      // first attempt to ACK
+    vector<StationStats> stations;
+
+    void add(const PacketRecord& packet) {
+        if (packet.station >= stations.size()) stations.resize(packet.station + 1);
+        StationStats& station = stations[packet.station];
+        station.retries += packet.retries;
+        retries += packet.retries;
+        end = std::max<SimTime>(end, packet.completionTime);
+        if (packet.outcome != PACKET_DELIVERED) {
+            station.dropped++;
+            dropped++;
+            return;
+        }
+        SimTime wait = packet.completionTime - packet.enqueueTime;
+        station.delivered++;
+        station.latencySum += wait;
+        station.maxLatency = std::max(station.maxLatency, wait);
+        delivered++;
+        deliveredBytes += packet.size;
+        latency.add(wait);
+        access.add(packet.completionTime - packet.firstAttempt);
+    }
+
+    void merge(const RunAnalysis& other) {
+        delivered += other.delivered;
+        dropped += other.dropped;
+        retries += other.retries;
+        deliveredBytes += other.deliveredBytes;
+        end = std::max(end, other.end);
+        latency.merge(other.latency);
+        access.merge(other.access);
+        if (stations.size() < other.stations.size()) stations.resize(other.stations.size());
+        for (size_t i = 0; i < other.stations.size(); ++i) {
+            stations[i].merge(other.stations[i]);
+        }
+    }
+};
+
+typedef map<RunKey, RunAnalysis> TraceAnalysis;
+
+TraceAnalysis analyzeTrace(const TraceReader& trace, int threads) {
+    vector<TraceSegment> pieces = trace.split(recordsPerPiece);
+    WorkStealingPool pool(threads);
+    vector<TraceAnalysis> partial(pool.size());
+    vector<size_t> order(pieces.size());
+    for (size_t i = 0; i < order.size(); ++i) order[i] = i;
+
+    pool.run(order, [&](size_t task, int worker) {
+        const TraceSegment& piece = pieces[task];
+        RunAnalysis& run = partial[worker][runKey(*piece.run)];
+        if (run.stations.empty()) run.stations.resize(piece.run->clients);
+        trace.forEachRecord(piece, [&run](const PacketRecord& packet) { run.add(packet); });
+    });
+
+    TraceAnalysis merged;
+    for (int w = 0; w < pool.size(); ++w) {
+        for (const auto& entry : partial[w]) {
+            merged[entry.first].merge(entry.second);
+        }
+    }
+    return merged;
+}
+
+void printRun(ostream& out, const RunKey& key, const RunAnalysis& run, uint32_t sampleEvery, bool perStation) {
+    out << "WiFi " << get<0>(key) << ", " << get<1>(key) << " clients, " << get<2>(key) << " packets, MCS "
+        << get<3>(key) << ", seed " << get<4>(key) << ", replication " << get<5>(key) << ":\n";
+    // A sampled trace holds every Nth packet, so totals scale by N
+    double throughput = run.end > 0 ? run.deliveredBytes * 8.0 * sampleEvery / toSeconds(run.end) / 1e6 : 0;
+    out << "  Delivered " << run.delivered * sampleEvery << ", dropped " << run.dropped * sampleEvery
+        << ", " << (run.delivered + run.dropped ? static_cast<double>(run.retries) / (run.delivered + run.dropped) : 0)
+        << " retries per packet, " << toMilliseconds(run.end) << " ms simulated\n";
+    out << "  Throughput: " << throughput << " Mbps\n";
+    out << "  Latency: mean " << run.latency.mean() / 1e6 << " ms, p50 " << toMilliseconds(run.latency.quantile(0.5))
+        << " ms, p90 " << toMilliseconds(run.latency.quantile(0.9)) << " ms, p99 "
+        << toMilliseconds(run.latency.quantile(0.99)) << " ms, p99.9 " << toMilliseconds(run.latency.quantile(0.999))
+        << " ms, max " << toMilliseconds(run.latency.max()) << " ms\n";
+    out << "  Access delay: mean " << run.access.mean() / 1e6 << " ms, p99 " << toMilliseconds(run.access.quantile(0.99))
+        << " ms, max " << toMilliseconds(run.access.max()) << " ms\n";
+    if (!perStation) return;
+    out << "  " << setw(8) << "station" << setw(12) << "delivered" << setw(10) << "dropped" << setw(10) << "retries"
+        << setw(14) << "mean (ms)" << setw(14) << "max (ms)" << "\n";
+    for (size_t i = 0; i < run.stations.size(); ++i) {
+        const StationStats& station = run.stations[i];
+        double mean = station.delivered ? station.latencySum / 1e6 / station.delivered : 0;
+        out << "  " << setw(8) << i << setw(12) << station.delivered * sampleEvery << setw(10)
+            << station.dropped * sampleEvery << setw(10) << station.retries * sampleEvery << setw(14) << mean
+            << setw(14) << toMilliseconds(station.maxLatency) << "\n";
+    }
+}
+
+void printUsage(const char* program) {
+    cerr << "Usage: " << program << " TRACE [--threads T] [--stations]\n"
+         << "Summarizes a file written by wifi.exe --trace; T = 0 (default) uses every hardware thread\n";
+}
+
+int main(int argc, char* argv[]) {
+    string path;
+    int threads = 0;
+    bool perStation = false;
+    try {
+        for (int i = 1; i < argc; ++i) {
+            string arg = argv[i];
+            if (arg == "--threads" && i + 1 < argc) {
+                threads = parseOptionValue<int>(arg, argv[++i], [](int t) { return t >= 0; },
+                                                "a thread count, 0 for every hardware thread");
+            } else if (arg == "--stations") {
+                perStation = true;
+            } else if (path.empty() && arg[0] != '-') {
+                path = arg;
+            } else {
+                path.clear();
+                break;
+            }
+        }
+    } catch (const invalid_argument& e) {
+        cerr << e.what() << "\n";
+        path.clear();
+    }
+    if (path.empty()) {
+        printUsage(argv[0]);
+        return 1;
+    }
+    if (threads == 0) {
+        threads = static_cast<int>(std::max(std::thread::hardware_concurrency(), 1u));
+    }
+
+    try {
+        auto start = chrono::steady_clock::now();
+        TraceReader trace(path);
+        TraceAnalysis runs = analyzeTrace(trace, threads);
+        double wallSeconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+        for (const auto& entry : runs) {
+            printRun(cout, entry.first, entry.second, trace.sampleEvery(), perStation);
+        }
+        if (trace.sampleEvery() > 1) {
+            cout << "Sampled 1 in " << trace.sampleEvery() << " packets; counts and throughput are scaled up\n";
+        }
+        double perRecord = trace.recordCount() ? static_cast<double>(trace.fileBytes()) / trace.recordCount() : 0;
+        cerr << "Scanned " << trace.recordCount() << (trace.isCompact() ? " compact" : " raw") << " records ("
+             << trace.fileBytes() / 1e6 << " MB, " << perRecord << " bytes per record) in "
+             << trace.getBlocks().size() << " blocks with " << threads << " threads in " << wallSeconds * 1000
+             << " ms (" << (wallSeconds > 0 ? trace.fileBytes() / 1e9 / wallSeconds : 0) << " GB/s)\n";
+    } catch (const exception& e) {
+        cerr << e.what() << "\n";
+        return 1;
+    }
+    return 0;
+}
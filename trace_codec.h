@@ -0,0 +1,213 @@
+#ifndef TRACE_CODEC_H
+#define TRACE_CODEC_H
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <stdexcept>
+#include <vector>
+
+#include "sim_engine.h"
+
+// Compact encoding of PacketRecords. Times are converted to integer ticks
+// (tickNs nanoseconds each, 1 keeps them exact) and each field is predicted
+// from what came before; only the zigzag varint of the miss is stored, and
+// a field predicted exactly is left out. A record starts with a head byte:
+//   bit 0       size changed: the new size follows (plain varint)
+//   bit 1       completion moved from the previous record's
+//   bit 2       enqueue time differs from the station's previous completion;
+//               with saturated queues the next packet is queued right then
+//   bit 3       first attempt given (always set for retried packets)
+//   bit 4       outcome (PacketOutcome)
+//   bits 5-7    retries; 7 means 7 + a plain varint
+// followed by the station (from the previous record's) and the fields the
+// flags ask for, in that order. A packet sent once is predicted to have the
+// same access time (completion - first attempt) as the last such packet;
+// for a retried one the first attempt is stored from its enqueue time.
+// Predictions restart at every block, so blocks decode independently.
+// A WiFi 4 record under heavy contention takes under 8 bytes instead of 32,
+// a WiFi 5 or 6 one about 3.
+
+enum PacketOutcome : uint8_t {
+    PACKET_DELIVERED = 0,
+    PACKET_DROPPED = 1   // retry limit exhausted
+};
+
+struct PacketRecord {
+    int64_t enqueueTime;      // ns; when the packet reached the head of its queue
+    int64_t firstAttempt;     // ns; start of its first transmission
+    int64_t completionTime;   // ns; ACK, or end of the last failed attempt
+    uint32_t station;
+    uint16_t size;            // bytes
+    uint8_t retries;          // failed attempts before the outcome
+    uint8_t outcome;          // PacketOutcome
+};
+static_assert(sizeof(PacketRecord) == 32, "PacketRecord is a 32-byte on-disk format");
+
+// Upper bound on one encoded record: the head byte and six varints of at
+// most 10 bytes
+constexpr size_t maxEncodedRecord = 64;
+
+enum TraceRecordFlags : uint8_t {
+    TRACE_SIZE = 1,
+    TRACE_COMPLETION = 2,
+    TRACE_ENQUEUE = 4,
+    TRACE_FIRST_ATTEMPT = 8,
+    TRACE_DROPPED = 16,
+    TRACE_RETRY_SHIFT = 5,
+    TRACE_RETRY_ESCAPE = 7
+};
+
+inline uint64_t zigzag(int64_t v) { return (static_cast<uint64_t>(v) << 1) ^ static_cast<uint64_t>(v >> 63); }
+inline int64_t unzigzag(uint64_t v) { return static_cast<int64_t>(v >> 1) ^ -static_cast<int64_t>(v & 1); }
+
+inline uint8_t* putVarint(uint8_t* out, uint64_t v) {
+    while (v >= 0x80) {
+        *out++ = static_cast<uint8_t>(v) | 0x80;
+        v >>= 7;
+    }
+    *out++ = static_cast<uint8_t>(v);
+    return out;
+}
+
+inline const uint8_t* getVarint(const uint8_t* in, const uint8_t* end, uint64_t& v) {
+    if (in < end && *in < 0x80) {   // most deltas fit in one byte
+        v = *in;
+        return in + 1;
+    }
+    v = 0;
+    for (int shift = 0; in < end && shift < 64; shift += 7) {
+        uint8_t byte = *in++;
+        v |= static_cast<uint64_t>(byte & 0x7f) << shift;
+        if (byte < 0x80) return in;
+    }
+    throw std::invalid_argument("corrupt varint in trace block");
+}
+
+// Prediction state shared by the encoder and the decoder
+class TracePredictor {
+protected:
+    int64_t tickNs;
+    int64_t station;
+    int64_t completion;   // ticks
+    int64_t access;       // ticks, completion - first attempt of the last packet sent once
+    uint16_t size;
+    std::vector<int64_t> lastCompletion;   // per station, ticks
+
+    int64_t& stationCompletion(uint32_t s) {
+        if (s >= lastCompletion.size()) lastCompletion.resize(s + 1, 0);
+        return lastCompletion[s];
+    }
+
+public:
+    explicit TracePredictor(int64_t tickNs = 1) : tickNs(tickNs > 0 ? tickNs : 1) { reset(); }
+
+    void setTick(int64_t ns) { tickNs = ns > 0 ? ns : 1; }
+
+    // Start of a block; keeps the per-station table's memory
+    void reset() {
+        station = 0;
+        completion = 0;
+        access = 0;
+        size = 0;
+        std::fill(lastCompletion.begin(), lastCompletion.end(), 0);
+    }
+};
+
+class TraceEncoder : public TracePredictor {
+public:
+    using TracePredictor::TracePredictor;
+
+    // Writes at most maxEncodedRecord bytes; returns the end of the record
+    uint8_t* encode(uint8_t* out, const PacketRecord& packet) {
+        int64_t done = packet.completionTime / tickNs;
+        int64_t queued = packet.enqueueTime / tickNs;
+        int64_t first = packet.firstAttempt / tickNs;
+        int64_t& previous = stationCompletion(packet.station);
+        bool sent = packet.retries == 0 && done - first == access;
+        uint8_t* head = out++;
+        *head = static_cast<uint8_t>((packet.size != size ? TRACE_SIZE : 0) | (done != completion ? TRACE_COMPLETION : 0) |
+                                     (queued != previous ? TRACE_ENQUEUE : 0) | (sent ? 0 : TRACE_FIRST_ATTEMPT) |
+                                     (packet.outcome == PACKET_DROPPED ? TRACE_DROPPED : 0) |
+                                     std::min<int>(packet.retries, TRACE_RETRY_ESCAPE) << TRACE_RETRY_SHIFT);
+        if (packet.retries >= TRACE_RETRY_ESCAPE) out = putVarint(out, packet.retries - TRACE_RETRY_ESCAPE);
+        if (*head & TRACE_SIZE) out = putVarint(out, packet.size);
+        out = putVarint(out, zigzag(static_cast<int64_t>(packet.station) - station));
+        if (*head & TRACE_COMPLETION) out = putVarint(out, zigzag(done - completion));
+        if (*head & TRACE_ENQUEUE) out = putVarint(out, zigzag(queued - previous));
+        if (*head & TRACE_FIRST_ATTEMPT) {
+            out = putVarint(out, packet.retries ? zigzag(first - queued) : zigzag(done - first - access));
+        }
+        if (packet.retries == 0) access = done - first;
+        size = packet.size;
+        station = packet.station;
+        completion = done;
+        previous = done;
+        return out;
+    }
+};
+
+class TraceDecoder : public TracePredictor {
+private:
+    uint32_t stations;
+
+public:
+    explicit TraceDecoder(int64_t tickNs = 1) : TracePredictor(tickNs), stations(0) {}
+
+    // Start of a block of a run with `clients` stations
+    void begin(uint32_t clients) {
+        reset();
+        stations = clients;
+    }
+
+    // Reads one record from [in, end); returns the start of the next one
+    const uint8_t* decode(const uint8_t* in, const uint8_t* end, PacketRecord& packet) {
+        if (in == end) throw std::invalid_argument("trace block ends early");
+        uint8_t head = *in++;
+        uint64_t v;
+        uint64_t retries = head >> TRACE_RETRY_SHIFT;
+        if (retries == TRACE_RETRY_ESCAPE) {
+            in = getVarint(in, end, v);
+            retries += v;
+        }
+        if (head & TRACE_SIZE) {
+            in = getVarint(in, end, v);
+            size = static_cast<uint16_t>(v);
+        }
+        in = getVarint(in, end, v);
+        station += unzigzag(v);
+        if (station < 0 || station >= stations) throw std::invalid_argument("trace record names a station out of range");
+        if (head & TRACE_COMPLETION) {
+            in = getVarint(in, end, v);
+            completion += unzigzag(v);
+        }
+        int64_t& previous = stationCompletion(static_cast<uint32_t>(station));
+        int64_t queued = previous;
+        if (head & TRACE_ENQUEUE) {
+            in = getVarint(in, end, v);
+            queued += unzigzag(v);
+        }
+        int64_t first;
+        if (retries) {
+            in = getVarint(in, end, v);
+            first = queued + unzigzag(v);
+        } else {
+            if (head & TRACE_FIRST_ATTEMPT) {
+                in = getVarint(in, end, v);
+                access += unzigzag(v);
+            }
+            first = completion - access;
+        }
+        previous = completion;
+        packet.enqueueTime = queued * tickNs;
+        packet.firstAttempt = first * tickNs;
+        packet.completionTime = completion * tickNs;
+        packet.station = static_cast<uint32_t>(station);
+        packet.size = size;
+        packet.retries = static_cast<uint8_t>(retries);
+        packet.outcome = head & TRACE_DROPPED ? PACKET_DROPPED : PACKET_DELIVERED;
+        return in;
+    }
+};
+
+#endif
@@ -0,0 +1,174 @@
+#ifndef TRACE_READER_H
+#define TRACE_READER_H
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "trace_writer.h"
+
+// Read-only memory map of a whole file. Pages are loaded on first touch and
+// can be dropped by the kernel at any time, so a file far larger than
+// memory can be scanned.
+class MappedFile {
+private:
+    const char* base;
+    size_t length;
+
+public:
+    explicit MappedFile(const std::string& path) : base(nullptr), length(0) {
+        int fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0) throw std::runtime_error("cannot open '" + path + "'");
+        struct stat info;
+        if (::fstat(fd, &info) != 0) {
+            ::close(fd);
+            throw std::runtime_error("cannot stat '" + path + "'");
+        }
+        length = static_cast<size_t>(info.st_size);
+        if (length > 0) {
+            void* p = ::mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (p == MAP_FAILED) {
+                ::close(fd);
+                throw std::runtime_error("cannot map '" + path + "'");
+            }
+            base = static_cast<const char*>(p);
+            ::madvise(p, length, MADV_SEQUENTIAL);
+        }
+        ::close(fd);   // the mapping keeps the file open
+    }
+
+    ~MappedFile() {
+        if (base) ::munmap(const_cast<char*>(base), length);
+    }
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    const char* data() const { return base; }
+    size_t size() const { return length; }
+
+    // Drops the whole pages in [from, to) from memory; they are read back
+    // from the file if touched again
+    void release(size_t from, size_t to) const {
+        const size_t page = static_cast<size_t>(::sysconf(_SC_PAGESIZE));
+        from = (from + page - 1) / page * page;
+        to = std::min(to, length) / page * page;
+        if (base && from < to) ::madvise(const_cast<char*>(base) + from, to - from, MADV_DONTNEED);
+    }
+};
+
+// Records of one block, or a slice of a raw block, in place in the mapping
+struct TraceSegment {
+    const TraceBlockHeader* run;
+    const char* payload;
+    size_t count;
+    size_t bytes;
+};
+
+// Validates a trace written by TraceWriter and lists its blocks. Opening
+// only touches the block headers (one page per block), not the records;
+// forEachRecord() decodes a block wherever it is, so blocks can be read in
+// any order and on any thread.
+class TraceReader {
+private:
+    MappedFile file;
+    TraceFileHeader header;
+    std::vector<TraceSegment> blocks;
+    bool compact;
+
+public:
+    explicit TraceReader(const std::string& path) : file(path), header(), compact(false) {
+        if (file.size() < sizeof(TraceFileHeader)) {
+            throw std::invalid_argument("'" + path + "' is too short for a trace");
+        }
+        std::memcpy(&header, file.data(), sizeof(header));
+        if (std::memcmp(header.magic, traceMagic, sizeof(traceMagic)) != 0) {
+            throw std::invalid_argument("'" + path + "' is not a packet trace");
+        }
+        if (header.version < 1 || header.version > traceVersion || header.recordSize != sizeof(PacketRecord)) {
+            throw std::invalid_argument("'" + path + "': unsupported trace version " + std::to_string(header.version));
+        }
+        if (header.version == 1) {
+            header.encoding = static_cast<uint32_t>(TraceEncoding::Raw);
+            header.tickNs = 1;
+        }
+        if (header.encoding > static_cast<uint32_t>(TraceEncoding::Compact)) {
+            throw std::invalid_argument("'" + path + "': unknown record encoding " + std::to_string(header.encoding));
+        }
+        compact = header.encoding == static_cast<uint32_t>(TraceEncoding::Compact);
+        // Headers and raw records are 32 bytes, so the mapping keeps raw
+        // blocks aligned; compact blocks are read byte by byte
+        size_t offset = sizeof(TraceFileHeader);
+        while (offset < file.size()) {
+            if (file.size() - offset < sizeof(TraceBlockHeader)) {
+                throw std::invalid_argument("'" + path + "': truncated block header at byte " + std::to_string(offset));
+            }
+            const TraceBlockHeader* run = reinterpret_cast<const TraceBlockHeader*>(file.data() + offset);
+            offset += sizeof(TraceBlockHeader);
+            size_t bytes = compact ? run->payloadBytes : static_cast<size_t>(run->recordCount) * sizeof(PacketRecord);
+            if (file.size() - offset < bytes) {
+                throw std::invalid_argument("'" + path + "': truncated block at byte " + std::to_string(offset));
+            }
+            blocks.push_back(TraceSegment{run, file.data() + offset, run->recordCount, bytes});
+            offset += bytes;
+        }
+    }
+
+    uint32_t sampleEvery() const { return header.sampleEvery ? header.sampleEvery : 1; }
+    bool isCompact() const { return compact; }
+    uint32_t tickNs() const { return header.tickNs ? header.tickNs : 1; }
+    size_t fileBytes() const { return file.size(); }
+    const std::vector<TraceSegment>& getBlocks() const { return blocks; }
+
+    uint64_t recordCount() const {
+        uint64_t n = 0;
+        for (const TraceSegment& block : blocks) n += block.count;
+        return n;
+    }
+
+    // The blocks cut into pieces of at most maxRecords records, in file
+    // order, for spreading a scan over threads. Compact blocks decode from
+    // their start only, so they stay whole.
+    std::vector<TraceSegment> split(size_t maxRecords) const {
+        if (compact) return blocks;
+        std::vector<TraceSegment> pieces;
+        for (const TraceSegment& block : blocks) {
+            for (size_t first = 0; first < block.count; first += maxRecords) {
+                size_t count = std::min(maxRecords, block.count - first);
+                pieces.push_back(TraceSegment{block.run, block.payload + first * sizeof(PacketRecord), count,
+                                              count * sizeof(PacketRecord)});
+            }
+        }
+        return pieces;
+    }
+
+    // Calls visit(const PacketRecord&) for every record of the segment, in order
+    template <typename Visit>
+    void forEachRecord(const TraceSegment& segment, Visit visit) const {
+        if (!compact) {
+            const PacketRecord* records = reinterpret_cast<const PacketRecord*>(segment.payload);
+            for (size_t i = 0; i < segment.count; ++i) visit(records[i]);
+            return;
+        }
+        TraceDecoder decoder(tickNs());
+        decoder.begin(segment.run->clients);
+        const uint8_t* in = reinterpret_cast<const uint8_t*>(segment.payload);
+        const uint8_t* end = in + segment.bytes;
+        PacketRecord packet;
+        for (size_t i = 0; i < segment.count; ++i) {
+            in = decoder.decode(in, end, packet);
+            visit(packet);
+        }
+    }
+};
+
+#endif
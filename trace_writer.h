@@ -0,0 +1,276 @@
+#ifndef TRACE_WRITER_H
+#define TRACE_WRITER_H
+
+#include <algorithm>
+#include <condition_variable>
+#include <cstdint>
+#include <cstring>
+#include <deque>
+#include <fstream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "sim_engine.h"
+#include "timeline.h"
+#include "trace_codec.h"
+
+// Binary per-packet trace. A file is a TraceFileHeader followed by blocks;
+// a block is a TraceBlockHeader naming the run its packets belong to,
+// followed by payloadBytes bytes holding recordCount records, either as
+// fixed-width PacketRecords or compact-encoded (see trace_codec.h). All
+// fields are little-endian. Blocks from different worker threads
+// interleave in the order they were flushed, and a long run spans several
+// blocks, so readers group records by the block header, never by position
+// in the file. Version 1 files are raw and leave payloadBytes at 0.
+
+enum class TraceEncoding : uint32_t {
+    Raw = 0,       // 32-byte PacketRecords
+    Compact = 1    // delta + zigzag + varint, see trace_codec.h
+};
+
+struct TraceFileHeader {
+    char magic[8];            // "WIFITRC"
+    uint32_t version;         // 2; version 1 had only raw records
+    uint32_t recordSize;      // sizeof(PacketRecord)
+    uint32_t sampleEvery;     // 1-in-N sampling; 1 keeps every packet
+    uint32_t encoding;        // TraceEncoding
+    uint32_t tickNs;          // time unit of compact records; 0 in version 1 (ns)
+    uint32_t reserved;
+};
+static_assert(sizeof(TraceFileHeader) == 32, "TraceFileHeader is a 32-byte on-disk format");
+
+struct TraceBlockHeader {
+    uint32_t recordCount;
+    uint16_t generation;
+    uint16_t mcs;
+    uint32_t clients;
+    uint32_t packets;
+    uint32_t replication;
+    uint32_t payloadBytes;
+    uint64_t seed;
+};
+static_assert(sizeof(TraceBlockHeader) == 32, "TraceBlockHeader is a 32-byte on-disk format");
+
+constexpr char traceMagic[8] = {'W', 'I', 'F', 'I', 'T', 'R', 'C', '\0'};
+constexpr uint32_t traceVersion = 2;
+
+// A chunk of encoded blocks on its way to the file
+struct TraceBuffer {
+    std::vector<char> bytes;
+    size_t used = 0;
+    bool inFlight = false;    // queued for or being written by the writer thread
+};
+
+// Owns the trace file and a background thread that writes submitted
+// buffers in one sequential write each, so the simulation threads only
+// ever copy records into memory.
+class TraceWriter {
+private:
+    std::ofstream out;
+    uint32_t sampleEvery;
+    TraceEncoding encoding;
+    uint32_t tickNs;
+    std::thread thread;
+    std::mutex lock;
+    std::condition_variable wake;      // work for the writer thread
+    std::condition_variable written;   // a buffer came back
+    std::deque<TraceBuffer*> pending;
+    bool closing;
+    uint64_t bytesWritten;
+
+    void writeLoop() {
+        Timeline::instance().nameThread("trace writer");
+        std::unique_lock<std::mutex> guard(lock);
+        while (true) {
+            wake.wait(guard, [&] { return closing || !pending.empty(); });
+            if (pending.empty()) return;
+            TraceBuffer* buffer = pending.front();
+            pending.pop_front();
+            guard.unlock();
+            {
+                TimelineScope span("trace flush", "trace");
+                span.arg("bytes", static_cast<int64_t>(buffer->used));
+                out.write(buffer->bytes.data(), static_cast<std::streamsize>(buffer->used));
+            }
+            guard.lock();
+            bytesWritten += buffer->used;
+            buffer->used = 0;
+            buffer->inFlight = false;
+            written.notify_all();
+        }
+    }
+
+public:
+    TraceWriter(const std::string& path, uint32_t sampleEvery, TraceEncoding encoding = TraceEncoding::Compact,
+                uint32_t tickNs = 1)
+        : out(path, std::ios::binary | std::ios::trunc), sampleEvery(sampleEvery ? sampleEvery : 1),
+          encoding(encoding), tickNs(tickNs ? tickNs : 1), closing(false), bytesWritten(0) {
+        TraceFileHeader header = {};
+        std::memcpy(header.magic, traceMagic, sizeof(header.magic));
+        header.version = traceVersion;
+        header.recordSize = sizeof(PacketRecord);
+        header.sampleEvery = this->sampleEvery;
+        header.encoding = static_cast<uint32_t>(encoding);
+        header.tickNs = this->tickNs;
+        out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        bytesWritten = sizeof(header);
+        thread = std::thread(&TraceWriter::writeLoop, this);
+    }
+
+    ~TraceWriter() { close(); }
+
+    TraceWriter(const TraceWriter&) = delete;
+    TraceWriter& operator=(const TraceWriter&) = delete;
+
+    // Writes what was submitted and stops the thread
+    void close() {
+        {
+            std::lock_guard<std::mutex> guard(lock);
+            if (closing) return;
+            closing = true;
+        }
+        wake.notify_one();
+        thread.join();
+        out.close();
+    }
+
+    // False once the file failed to open or any write to it failed; only
+    // final after close(), which flushes the last buffers
+    bool good() const { return static_cast<bool>(out); }
+    uint32_t getSampleEvery() const { return sampleEvery; }
+    TraceEncoding getEncoding() const { return encoding; }
+    uint32_t getTickNs() const { return tickNs; }
+    uint64_t getBytesWritten() const { return bytesWritten; }   // after close()
+
+    void submit(TraceBuffer& buffer) {
+        {
+            std::lock_guard<std::mutex> guard(lock);
+            buffer.inFlight = true;
+            pending.push_back(&buffer);
+        }
+        wake.notify_one();
+    }
+
+    void waitUntilWritten(TraceBuffer& buffer) {
+        TimelineScope span("trace wait", "trace");   // the simulation stalls on the writer
+        std::unique_lock<std::mutex> guard(lock);
+        written.wait(guard, [&] { return !buffer.inFlight; });
+    }
+};
+
+// Per-thread front end of a TraceWriter, double-buffered: records are
+// encoded into one buffer while the writer thread drains the other, and a
+// full buffer is swapped out instead of flushed in place. Each run is a
+// block; beginRun() opens it and endRun() closes it. With 1-in-N sampling
+// every Nth packet of a run is kept.
+class PacketTracer {
+private:
+    TraceWriter& writer;
+    TraceBuffer buffers[2];
+    int current;
+    size_t blockStart;           // offset of the open block's header
+    TraceBlockHeader block;
+    bool blockOpen;
+    uint32_t sampleEvery;
+    uint32_t sinceSample;
+    bool compact;
+    TraceEncoder encoder;
+
+    void openBlock() {
+        TraceBuffer& buffer = buffers[current];
+        blockStart = buffer.used;
+        buffer.used += sizeof(TraceBlockHeader);
+        block.recordCount = 0;
+        encoder.reset();
+    }
+
+    void closeBlock() {
+        TraceBuffer& buffer = buffers[current];
+        if (block.recordCount == 0) {
+            buffer.used = blockStart;   // nothing recorded: drop the header
+            return;
+        }
+        block.payloadBytes = static_cast<uint32_t>(buffer.used - blockStart - sizeof(TraceBlockHeader));
+        std::memcpy(buffer.bytes.data() + blockStart, &block, sizeof(block));
+    }
+
+    // Hands the full buffer to the writer and continues in the other one
+    void rotate() {
+        closeBlock();
+        writer.submit(buffers[current]);
+        current ^= 1;
+        writer.waitUntilWritten(buffers[current]);
+        openBlock();
+    }
+
+public:
+    // bufferBytes: size of each of the two buffers
+    explicit PacketTracer(TraceWriter& writer, size_t bufferBytes = size_t(1) << 20)
+        : writer(writer), current(0), blockStart(0), block(), blockOpen(false),
+          sampleEvery(writer.getSampleEvery()), sinceSample(0),
+          compact(writer.getEncoding() == TraceEncoding::Compact), encoder(writer.getTickNs()) {
+        for (TraceBuffer& buffer : buffers) {
+            buffer.bytes.resize(sizeof(TraceBlockHeader) + std::max(bufferBytes, 2 * maxEncodedRecord));
+        }
+    }
+
+    ~PacketTracer() {
+        flush();
+        writer.waitUntilWritten(buffers[0]);
+        writer.waitUntilWritten(buffers[1]);
+    }
+
+    PacketTracer(const PacketTracer&) = delete;
+    PacketTracer& operator=(const PacketTracer&) = delete;
+
+    void beginRun(const TraceBlockHeader& run) {
+        if (blockOpen) endRun();
+        block = run;
+        blockOpen = true;
+        sinceSample = 0;
+        openBlock();
+    }
+
+    void endRun() {
+        if (!blockOpen) return;
+        closeBlock();
+        blockOpen = false;
+    }
+
+    void record(const PacketRecord& packet) {
+        if (++sinceSample < sampleEvery) return;
+        sinceSample = 0;
+        if (buffers[current].used + maxEncodedRecord > buffers[current].bytes.size()) {
+            rotate();
+        }
+        TraceBuffer& buffer = buffers[current];
+        char* out = buffer.bytes.data() + buffer.used;
+        if (compact) {
+            uint8_t* end = encoder.encode(reinterpret_cast<uint8_t*>(out), packet);
+            buffer.used = static_cast<size_t>(reinterpret_cast<char*>(end) - buffer.bytes.data());
+        } else {
+            std::memcpy(out, &packet, sizeof(packet));
+            buffer.used += sizeof(PacketRecord);
+        }
+        block.recordCount++;
+    }
+
+    // Submits whatever is buffered; the open run, if any, continues in a new block
+    void flush() {
+        bool reopen = blockOpen;
+        endRun();
+        if (buffers[current].used > 0) {
+            writer.submit(buffers[current]);
+            current ^= 1;
+            writer.waitUntilWritten(buffers[current]);
+        }
+        if (reopen) {
+            blockOpen = true;
+            openBlock();
+        }
+    }
+};
+
+#endif
@@ -0,0 +1,318 @@
+#ifndef TRAFFIC_REPLAY_H
+#define TRAFFIC_REPLAY_H
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "sim_engine.h"
+#include "trace_reader.h"
+
+// Recorded traffic for the access points, instead of saturated queues. An
+// arrivals file is an ArrivalFileHeader followed by `count` ArrivalRecords
+// sorted by time; all fields are little-endian. Replay streams the records
+// from a memory map and drops the pages behind its cursor, so a trace of
+// any length is replayed in constant memory: only the packets waiting in
+// the stations' queues are held.
+
+struct ArrivalFileHeader {
+    char magic[8];          // "WIFIARR"
+    uint32_t version;       // 1
+    uint32_t recordSize;    // sizeof(ArrivalRecord)
+    uint32_t stations;      // station ids are 0..stations-1
+    uint32_t reserved;
+    uint64_t count;         // records
+};
+static_assert(sizeof(ArrivalFileHeader) == 32, "ArrivalFileHeader is a 32-byte on-disk format");
+
+struct ArrivalRecord {
+    int64_t time;           // ns from the start of the trace
+    uint32_t station;
+    uint16_t size;          // bytes
+    uint16_t reserved;
+};
+static_assert(sizeof(ArrivalRecord) == 16, "ArrivalRecord is a 16-byte on-disk format");
+
+constexpr char arrivalMagic[8] = {'W', 'I', 'F', 'I', 'A', 'R', 'R', '\0'};
+constexpr uint32_t arrivalVersion = 1;
+
+// Pages of the map are given back every this many bytes of records
+constexpr size_t replayReleaseBytes = size_t(16) << 20;
+
+// A validated arrivals file. Opening it checks every record in one
+// sequential pass (times in order, stations in range), releasing the pages
+// as it goes, so that replay itself never has to fail. Read-only, so one
+// trace can be replayed by any number of threads at once.
+class ArrivalTrace {
+private:
+    MappedFile file;
+    ArrivalFileHeader header;
+    const ArrivalRecord* records;
+
+public:
+    explicit ArrivalTrace(const std::string& path) : file(path), header(), records(nullptr) {
+        if (file.size() < sizeof(ArrivalFileHeader)) {
+            throw std::invalid_argument("'" + path + "' is too short for an arrivals file");
+        }
+        std::memcpy(&header, file.data(), sizeof(header));
+        if (std::memcmp(header.magic, arrivalMagic, sizeof(arrivalMagic)) != 0) {
+            throw std::invalid_argument("'" + path + "' is not an arrivals file");
+        }
+        if (header.version != arrivalVersion || header.recordSize != sizeof(ArrivalRecord)) {
+            throw std::invalid_argument("'" + path + "': unsupported arrivals version " + std::to_string(header.version));
+        }
+        if ((file.size() - sizeof(header)) / sizeof(ArrivalRecord) < header.count) {
+            throw std::invalid_argument("'" + path + "': truncated, expected " + std::to_string(header.count) + " records");
+        }
+        if (header.stations == 0 || header.stations > static_cast<uint32_t>(INT32_MAX)) {
+            throw std::invalid_argument("'" + path + "': station count must be 1-" + std::to_string(INT32_MAX));
+        }
+        records = reinterpret_cast<const ArrivalRecord*>(file.data() + sizeof(header));
+        int64_t last = 0;
+        for (uint64_t i = 0; i < header.count; ++i) {
+            const ArrivalRecord& r = records[i];
+            if (r.time < last || r.station >= header.stations) {
+                throw std::invalid_argument("'" + path + "': record " + std::to_string(i) +
+                                            (r.time < last ? " is out of time order" : " names a station out of range"));
+            }
+            last = r.time;
+            if ((i + 1) % (replayReleaseBytes / sizeof(ArrivalRecord)) == 0) release(0, i + 1);
+        }
+        release(0, header.count);
+    }
+
+    uint32_t stations() const { return header.stations; }
+    uint64_t size() const { return header.count; }
+    const ArrivalRecord& operator[](uint64_t i) const { return records[i]; }
+
+    // Gives back the memory of records [first, last)
+    void release(uint64_t first, uint64_t last) const {
+        file.release(sizeof(header) + first * sizeof(ArrivalRecord), sizeof(header) + last * sizeof(ArrivalRecord));
+    }
+};
+
+struct QueuedPacket {
+    SimTime arrival;
+    uint16_t size;   // bytes
+};
+
+// One access point's replay of an ArrivalTrace: a cursor into the trace and
+// a FIFO per station of the packets that arrived but are not yet sent. A
+// station holding queueLimit packets drops new arrivals (tail drop), which
+// also bounds the memory when the trace offers more than the channel can
+// carry. Without a trace the access point runs saturated.
+class TrafficReplay {
+private:
+    struct StationQueue {
+        std::vector<QueuedPacket> packets;   // [head, end) are queued
+        size_t head = 0;
+    };
+
+    const ArrivalTrace* trace;
+    uint64_t next;
+    uint64_t released;
+    std::vector<StationQueue> queues;
+    size_t queueLimit;
+    uint64_t tailDrops;
+
+public:
+    static constexpr size_t defaultQueueLimit = 1000;
+
+    TrafficReplay() : trace(nullptr), next(0), released(0), queueLimit(defaultQueueLimit), tailDrops(0) {}
+
+    void setTrace(const ArrivalTrace* arrivals) { trace = arrivals; }
+    bool active() const { return trace != nullptr; }
+
+    // Rewinds to the first arrival with every queue empty
+    void start() {
+        next = 0;
+        released = 0;
+        tailDrops = 0;
+        queues.resize(trace->stations());
+        for (StationQueue& queue : queues) {
+            queue.packets.clear();
+            queue.head = 0;
+        }
+    }
+
+    bool pending() const { return next < trace->size(); }
+    SimTime nextArrival() const { return (*trace)[next].time; }
+
+    // Moves the next arrival into its station's queue; returns the station,
+    // or -1 when the queue was full and the packet was dropped
+    int32_t admit() {
+        const ArrivalRecord& r = (*trace)[next];
+        StationQueue& queue = queues[r.station];
+        int32_t station = static_cast<int32_t>(r.station);
+        if (queue.packets.size() - queue.head < queueLimit) {
+            queue.packets.push_back(QueuedPacket{r.time, r.size});
+        } else {
+            tailDrops++;
+            station = -1;
+        }
+        if (++next - released >= replayReleaseBytes / sizeof(ArrivalRecord)) {
+            trace->release(released, next);
+            released = next;
+        }
+        return station;
+    }
+
+    size_t queued(size_t station) const { return queues[station].packets.size() - queues[station].head; }
+    const QueuedPacket& head(size_t station) const { return queues[station].packets[queues[station].head]; }
+
+    // Removes the head-of-line packet once it is delivered or dropped
+    void retire(size_t station) {
+        StationQueue& queue = queues[station];
+        if (++queue.head == queue.packets.size()) {
+            queue.packets.clear();
+            queue.head = 0;
+        } else if (queue.head >= 1024 && 2 * queue.head >= queue.packets.size()) {
+            queue.packets.erase(queue.packets.begin(), queue.packets.begin() + static_cast<std::ptrdiff_t>(queue.head));
+            queue.head = 0;
+        }
+    }
+
+    uint64_t getTailDrops() const { return tailDrops; }
+};
+
+// Which address of a captured frame names its station
+enum class PcapStation { Source, Destination };
+
+struct PcapImport {
+    uint64_t frames = 0;      // written as arrivals
+    uint64_t skipped = 0;     // no usable address (control frames, truncated headers)
+    uint64_t reordered = 0;   // earlier than the frame before; moved up to its time
+    uint32_t stations = 0;
+    SimTime duration = 0;
+};
+
+// Station address of one captured frame as a 64-bit key; false when the
+// frame has none. MACs and IPv4 addresses fit as they are, IPv6 addresses
+// are folded.
+inline bool pcapAddress(uint32_t linkType, const uint8_t* frame, size_t length, PcapStation which, uint64_t& key) {
+    auto bytesKey = [&](size_t offset, size_t width) {
+        if (offset + width > length) return false;
+        key = 0;
+        for (size_t i = 0; i < width; ++i) {
+            key = width <= 8 ? key << 8 | frame[offset + i] : (key ^ frame[offset + i]) * 0x100000001b3ULL;
+        }
+        return true;
+    };
+    bool source = which == PcapStation::Source;
+    switch (linkType) {
+    case 1:     // Ethernet: destination, then source MAC
+        return bytesKey(source ? 6 : 0, 6);
+    case 127: { // radiotap header, then 802.11
+        if (length < 4) return false;
+        size_t header = frame[2] | static_cast<size_t>(frame[3]) << 8;
+        if (header > length) return false;
+        return pcapAddress(105, frame + header, length - header, which, key);
+    }
+    case 105:   // 802.11: data frames only; addr1 is the receiver, addr2 the transmitter
+        if (length < 2 || ((frame[0] >> 2) & 3) != 2) return false;
+        return bytesKey(source ? 10 : 4, 6);
+    case 101:   // raw IP
+    case 228:   // raw IPv4
+    case 229:   // raw IPv6
+        if (length < 1) return false;
+        if (frame[0] >> 4 == 4) return bytesKey(source ? 12 : 16, 4);
+        if (frame[0] >> 4 == 6) return bytesKey(source ? 8 : 24, 16);
+        return false;
+    default:
+        throw std::invalid_argument("unsupported pcap link type " + std::to_string(linkType) +
+                                    " (expected Ethernet, raw IP, 802.11 or radiotap)");
+    }
+}
+
+// Converts a classic pcap capture into an arrivals file: one arrival per
+// frame, its station numbered by first appearance of its address, its size
+// the original frame length (capped at 65535) and its time relative to the
+// first frame. The capture is memory-mapped and released as it is read, and
+// the arrivals are written through a fixed buffer, so captures of any size
+// convert in constant memory (plus one entry per distinct address).
+inline PcapImport importPcap(const std::string& pcapPath, const std::string& arrivalsPath, PcapStation which) {
+    MappedFile capture(pcapPath);
+    const uint8_t* data = reinterpret_cast<const uint8_t*>(capture.data());
+    const size_t length = capture.size();
+    if (length < 24) throw std::invalid_argument("'" + pcapPath + "' is too short for a pcap capture");
+    uint32_t magic;
+    std::memcpy(&magic, data, 4);
+    bool swapped = magic == 0xd4c3b2a1 || magic == 0x4d3cb2a1;
+    bool nanoseconds = magic == 0xa1b23c4d || magic == 0x4d3cb2a1;
+    if (!swapped && magic != 0xa1b2c3d4 && magic != 0xa1b23c4d) {
+        throw std::invalid_argument("'" + pcapPath + "' is not a pcap capture (pcapng is not supported)");
+    }
+    auto field = [&](size_t offset) {
+        uint32_t v;
+        std::memcpy(&v, data + offset, 4);
+        return swapped ? __builtin_bswap32(v) : v;
+    };
+    const uint32_t linkType = field(20) & 0xffff;
+
+    std::ofstream out(arrivalsPath, std::ios::binary | std::ios::trunc);
+    ArrivalFileHeader header = {};
+    std::memcpy(header.magic, arrivalMagic, sizeof(header.magic));
+    header.version = arrivalVersion;
+    header.recordSize = sizeof(ArrivalRecord);
+    out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+
+    PcapImport result;
+    std::unordered_map<uint64_t, uint32_t> stations;
+    std::vector<ArrivalRecord> buffer;
+    buffer.reserve(1 << 16);
+    int64_t first = -1;
+    int64_t last = 0;
+    size_t released = 0;
+    for (size_t offset = 24; offset < length;) {
+        if (length - offset < 16) throw std::invalid_argument("'" + pcapPath + "': truncated record header");
+        uint32_t captured = field(offset + 8);
+        uint32_t original = field(offset + 12);
+        if (length - offset - 16 < captured) throw std::invalid_argument("'" + pcapPath + "': truncated frame");
+        int64_t time = static_cast<int64_t>(field(offset)) * 1000000000 +
+                       static_cast<int64_t>(field(offset + 4)) * (nanoseconds ? 1 : 1000);
+        uint64_t key;
+        if (pcapAddress(linkType, data + offset + 16, captured, which, key)) {
+            if (first < 0) first = time;
+            time -= first;
+            if (time < last) {
+                result.reordered++;
+                time = last;
+            }
+            last = time;
+            auto station = stations.emplace(key, static_cast<uint32_t>(stations.size())).first->second;
+            buffer.push_back(ArrivalRecord{time, station, static_cast<uint16_t>(std::min<uint32_t>(original, 65535)), 0});
+            if (buffer.size() == buffer.capacity()) {
+                out.write(reinterpret_cast<const char*>(buffer.data()), buffer.size() * sizeof(ArrivalRecord));
+                result.frames += buffer.size();
+                buffer.clear();
+            }
+        } else {
+            result.skipped++;
+        }
+        offset += 16 + captured;
+        if (offset - released >= replayReleaseBytes) {
+            capture.release(released, offset);
+            released = offset;
+        }
+    }
+    out.write(reinterpret_cast<const char*>(buffer.data()), buffer.size() * sizeof(ArrivalRecord));
+    result.frames += buffer.size();
+    result.stations = static_cast<uint32_t>(stations.size());
+    result.duration = last;
+
+    header.stations = result.stations;
+    header.count = result.frames;
+    out.seekp(0);
+    out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    if (!out) throw std::runtime_error("cannot write '" + arrivalsPath + "'");
+    if (result.frames == 0) throw std::invalid_argument("'" + pcapPath + "' has no frames with a station address");
+    return result;
+}
+
+#endif
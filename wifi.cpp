@@ -7,341 +7,346 @@
 #include <string>
 #include <queue>
 #include <memory>
+#include <chrono>
+#include <sstream>
+#include <fstream>
+#include <ctime>
+#include <stdexcept>
 
-using namespace std;
-
-// Base exception class for WiFi errors
-class wifi_exception : public exception {
-protected:
-    string message;
-public:
-    explicit wifi_exception(const string& msg) : message(msg) {}
-    const char* what() const noexcept override { return message.c_str(); }
-};
+#include "access_points.h"
+#include "scenario_runner.h"
+#include "sweep.h"
 
-// Network packet class to handle data transmission (WiFi 4)
-class NetworkPacket {
-private:
-    int size;
-    double transmissionTime;
-    string type;
+using namespace std;
 
-public:
-    NetworkPacket(int sizeBytes, double bandwidth, double modulation, const string& packetType = "DATA")
-        : size(sizeBytes), type(packetType) {
-        if (sizeBytes <= 0 || bandwidth <= 0 || modulation <= 0) {
-            throw wifi_exception("Invalid packet parameters");
-        }
-        transmissionTime = (size * 8.0) / (bandwidth * modulation);
+// One CSV row per result, with a header
+void writeResultsCsv(std::ostream& out, const std::vector<SimulationResult>& results) {
+    out << "generation,clients,packets,mcs,seed,replication,delivered,dropped,warmup_discarded,simulated_s,"
+           "throughput_mbps,mean_latency_ms,p50_latency_ms,p90_latency_ms,p99_latency_ms,p999_latency_ms,"
+           "max_latency_ms,wall_s\n";
+    out << std::setprecision(9);
+    for (const SimulationResult& r : results) {
+        out << r.generation << ',' << r.clients << ',' << r.packets << ',' << r.mcs << ',' << r.seed << ','
+            << r.replication << ',' << r.delivered << ',' << r.dropped << ',' << r.warmupDiscarded << ','
+            << r.simulatedSeconds << ',' << r.throughputMbps << ',' << r.meanLatencyMs << ',' << r.p50LatencyMs << ','
+            << r.p90LatencyMs << ',' << r.p99LatencyMs << ',' << r.p999LatencyMs << ',' << r.maxLatencyMs << ','
+            << r.wallSeconds << '\n';
     }
+}
 
-    int getSize() const { return size; }
-    double getTransmissionTime() const { return transmissionTime; }
-    string getType() const { return type; }
-};
-
-// Frequency channel class to manage channel state
-class FreqChannel {
-public:
-    enum State { FREE, OCCUPIED };
-
-private:
-    State state;
-    string identifier;
-
-public:
-    FreqChannel(const string& id = "Default") : state(FREE), identifier(id) {}
-    
-    void setState(State newState) { state = newState; }
-    bool isAvailable() const { return state == FREE; }
-    string getIdentifier() const { return identifier; }
-};
-
-// Base network user class for WiFi 4
-class NetworkUser {
-protected:
-    int userID;
-    double backoffTime;
-    bool active;
-
-public:
-    NetworkUser(int id) : userID(id), backoffTime(0), active(true) {}
-    virtual ~NetworkUser() = default;
-
-    bool checkActivityStatus() const { return active; }
-    void setActivityStatus(bool status) { active = status; }
-    int getUserID() const { return userID; }
-};
-
-// WiFi 6 User implementation with OFDMA support
-class WiFi6User : public NetworkUser {
-private:
-    int allocatedSubChannel;
-public:
-    WiFi6User(int id) : NetworkUser(id), allocatedSubChannel(-1) {}
-
-    void allocateSubChannel(int subChannel) {
-        allocatedSubChannel = subChannel;
+// One CSV row per scenario: the mean and confidence-interval half-width of
+// its headline metrics across the replications
+void writeMergedCsv(std::ostream& out, const std::vector<Scenario>& scenarios,
+                    const std::vector<ScenarioOutcome>& outcomes, double confidence) {
+    out << "generation,clients,packets,mcs,seed,replications,throughput_mbps,throughput_ci,mean_latency_ms,"
+           "mean_latency_ci,p99_latency_ms,p99_latency_ci,wall_s\n";
+    out << std::setprecision(9);
+    for (size_t i = 0; i < scenarios.size(); ++i) {
+        const Scenario& s = scenarios[i];
+        const std::vector<SimulationResult>& results = outcomes[i].results;
+        ReplicationEstimate throughput = estimateAcrossReplications(results, confidence,
+            [](const SimulationResult& r) { return r.throughputMbps; });
+        ReplicationEstimate latency = estimateAcrossReplications(results, confidence,
+            [](const SimulationResult& r) { return r.meanLatencyMs; });
+        ReplicationEstimate tail = estimateAcrossReplications(results, confidence,
+            [](const SimulationResult& r) { return r.p99LatencyMs; });
+        double wallSeconds = 0;
+        for (const SimulationResult& r : results) wallSeconds += r.wallSeconds;
+        out << s.generation << ',' << s.clients << ',' << s.packets << ',' << s.mcs << ',' << s.seed << ','
+            << results.size() << ',' << throughput.mean << ',' << throughput.halfWidth << ',' << latency.mean << ','
+            << latency.halfWidth << ',' << tail.mean << ',' << tail.halfWidth << ',' << wallSeconds << '\n';
     }
+}
 
-    int getAllocatedSubChannel() const {
-        return allocatedSubChannel;
+// Non-interactive mode: a sweep from the command line and/or a scenario file
+struct BatchOptions {
+    SweepSpec sweep;           // run when a generation is given
+    std::string scenarioFile;
+    std::string outputFile;    // stdout when empty
+    std::string arrivalsFile;  // replayed traffic, which sets every scenario's clients and packets
+    bool merged = false;       // one row per scenario instead of per replication
+
+    BatchOptions() {
+        sweep.clients = {1, 10, 100};
+        sweep.packets = {1000};
+        sweep.mcs = {defaultMcs};
     }
 
-    bool attemptTransmission(FreqChannel& channel, int subChannel) {
-        if (allocatedSubChannel == subChannel && channel.isAvailable()) {
-            channel.setState(FreqChannel::OCCUPIED);
-            return true;
-        }
-        return false;
-    }
+    bool requested() const { return !sweep.generations.empty() || !scenarioFile.empty() || !arrivalsFile.empty(); }
 };
 
-// WiFi 4 User class simulating behavior
-class WiFiUser {
-private:
-    int id;
-    double backoffInterval;
-    int collisionCount;
-    bool waitingForAccess;
-
-public:
-    WiFiUser(int id) : id(id), collisionCount(0), waitingForAccess(false) {
-        resetBackoffInterval();
-    }
-
-    void resetBackoffInterval() {
-        backoffInterval = std::min((rand() % 21 + 1) * pow(2, collisionCount), 450.0);
+int runBatch(BatchOptions batch, const SimulationOptions& options) {
+    if (batch.sweep.seeds.empty()) batch.sweep.seeds = {static_cast<int64_t>(options.seed)};
+    // A replayed trace has its own stations and packets; WiFi 4 unless a
+    // generation is given
+    const int replayPackets = options.arrivals ? static_cast<int>(std::min<uint64_t>(options.arrivals->size(), INT32_MAX)) : 0;
+    if (options.arrivals) {
+        batch.sweep.clients = {static_cast<int64_t>(options.arrivals->stations())};
+        batch.sweep.packets = {replayPackets};
+        if (batch.sweep.generations.empty() && batch.scenarioFile.empty()) batch.sweep.generations = {4};
     }
-
-    bool attemptToTransmit(FreqChannel &channel, double &latency, double congestionFactor) {
-        if (waitingForAccess) {
-            waitingForAccess = false;
-            return false;
+    std::vector<Scenario> scenarios;
+    try {
+        if (!batch.scenarioFile.empty()) {
+            std::ifstream in(batch.scenarioFile);
+            if (!in) throw std::invalid_argument("cannot open " + batch.scenarioFile);
+            scenarios = readScenarios(in, batch.scenarioFile, batch.sweep);
+            for (Scenario& scenario : scenarios) {
+                if (!options.arrivals) break;
+                scenario.clients = static_cast<int>(options.arrivals->stations());
+                scenario.packets = replayPackets;
+            }
         }
-
-        bool collisionOccurred = (rand() % 150 < congestionFactor * 100);
-
-        if (!collisionOccurred) {
-            channel.setState(FreqChannel::OCCUPIED);
-            latency += backoffInterval;
-            collisionCount = 0;
-            channel.setState(FreqChannel::FREE);
-            return true;
-        } else {
-            collisionCount++;
-            resetBackoffInterval();
-            waitingForAccess = true;
-            return false;
+        if (!batch.sweep.generations.empty()) {
+            size_t first = scenarios.size();
+            batch.sweep.expand(scenarios);
+            for (size_t i = first; i < scenarios.size(); ++i) {
+                validateScenario(scenarios[i]);
+            }
         }
+    } catch (const std::invalid_argument& e) {
+        cerr << e.what() << "\n";
+        return 1;
     }
 
-    double getBackoffInterval() const { return backoffInterval; }
-};
-
-// WiFi 4 Access Point class to manage network activity
-class WiFi4AccessPoint {
-private:
-    FreqChannel channel;
-    std::vector<WiFiUser> clients;
-    std::vector<double> latencyRecords;
-    int successfulTransfers;
-    double totalDuration;
-    const double transferRate;
-    const double packetSizeInBits;
-
-public:
-    WiFi4AccessPoint() : 
-        successfulTransfers(0), 
-        totalDuration(0),
-        transferRate(20e6 * 8 * (5.0 / 6.0)),
-        packetSizeInBits(1024 * 8) {}
-
-    void addClient(const WiFiUser& client) {
-        clients.push_back(client);
-    }
-
-    void simulateNetwork(int numPackets) {
-        latencyRecords.clear();
-        successfulTransfers = 0;
-        totalDuration = 0;
-
-        const double idealDuration = packetSizeInBits / transferRate;
-        const double congestion = std::min(0.05 * clients.size(), 0.5);
-
-        if (clients.size() == 1) {
-            // Single user scenario - ideal situation
-            for (int i = 0; i < numPackets; ++i) {
-                latencyRecords.push_back(idealDuration * 1000);
-                successfulTransfers++;
-                totalDuration += idealDuration;
-            }
-        } else {
-            // Multiple users scenario
-            for (int packetIndex = 0; packetIndex < numPackets; ++packetIndex) {
-                for (auto &client : clients) {
-                    double contentionDelay = (rand() % 50) * 0.001;
-                    double backoffDelay = client.getBackoffInterval();
-                    double totalLatency = contentionDelay + backoffDelay;
-
-                    if (client.attemptToTransmit(channel, totalLatency, congestion)) {
-                        totalLatency += idealDuration * 1000;
-                        latencyRecords.push_back(totalLatency);
-                        successfulTransfers++;
-                    }
-                    totalDuration += (totalLatency / 1000);
-                }
-            }
+    RunnerStats stats;
+    std::vector<ScenarioOutcome> outcomes = runScenarios(scenarios, options, false, stats);
+    printRunnerStats(cerr, stats);   // stdout carries the CSV
+    for (const ScenarioOutcome& outcome : outcomes) cerr << outcome.profile;
+
+    std::ofstream file;
+    if (!batch.outputFile.empty()) file.open(batch.outputFile);
+    std::ostream& out = batch.outputFile.empty() ? cout : file;
+    if (batch.merged) {
+        writeMergedCsv(out, scenarios, outcomes, options.stopping.confidence);
+    } else {
+        std::vector<SimulationResult> results;
+        for (const ScenarioOutcome& outcome : outcomes) {
+            results.insert(results.end(), outcome.results.begin(), outcome.results.end());
         }
+        writeResultsCsv(out, results);
     }
+    if (!out) {
+        cerr << "Cannot write " << batch.outputFile << "\n";
+        return 1;
+    }
+    return 0;
+}
 
-    void displayStatistics() const {
-        std::cout << "--------------------------------------------------------\n";
-        std::cout << "Simulation Results for " << clients.size() << " Clients:\n";
-
-        double maxPossibleThroughput = transferRate / 1e6;
-        double actualThroughput = (successfulTransfers * packetSizeInBits) / (totalDuration);
-        double achievableThroughput = std::min(actualThroughput / 1e6, maxPossibleThroughput);
-
-        double avgLatency = latencyRecords.empty() ? 0 : 
-            std::accumulate(latencyRecords.begin(), latencyRecords.end(), 0.0) / latencyRecords.size();
-        double peakLatency = latencyRecords.empty() ? 0 : 
-            *std::max_element(latencyRecords.begin(), latencyRecords.end());
+void printUsage(const char* program) {
+    cerr << "Usage: " << program << " [--queue heap|wheel] [--contention event|slotted|lockstep] [--replications R] [--latency-bits B] [--ci-target REL] [--confidence C] [--warmup mser5|none] [--seed N]\n"
+         << "       [--generation LIST] [--clients LIST] [--packets LIST] [--mcs LIST] [--seeds LIST] [--sweep SPEC]\n"
+         << "       [--scenarios FILE] [--threads T] [--output FILE] [--merged]\n"
+         << "       [--trace FILE] [--trace-sample N] [--trace-encoding compact|raw] [--trace-tick NS]\n"
+         << "       [--arrivals FILE] [--import-pcap PCAP] [--import-by src|dst] [--perf-counters] [--timeline FILE]\n"
+         << "LIST is comma-separated values and FIRST:LAST[:STEP] ranges; SPEC is e.g. \"generation=4,5 clients=1:100:9 mcs=0:9\"\n";
+}
 
-        std::cout << "Throughput: " << maxPossibleThroughput << " Mbps\n"
-                  << "Achievable Throughput: " << achievableThroughput << " Mbps\n"
-                  << "Average Latency: " << avgLatency << " ms\n"
-                  << "Peak Latency: " << peakLatency << " ms\n";
+// Applies sweep assignments given on the command line; reports a malformed
+// one and returns false
+bool parseSweepArgument(SweepSpec& sweep, const std::string& spec) {
+    try {
+        sweep.parse(spec);
+        return true;
+    } catch (const std::invalid_argument& e) {
+        cerr << e.what() << "\n";
+        return false;
     }
-};
-
-// WiFi 5 Access Point implementation with MU-MIMO support
-class WiFi5AccessPoint {
-private:
-    FreqChannel channel;
-    vector<WiFiUser*> users;
+}
 
-public:
-    WiFi5AccessPoint() : channel("WiFi5_Channel") {}
+// Writes the --timeline file as main returns; declared before the trace
+// writer, whose thread has stopped by then
+struct TimelineOutput {
+    std::string path;
 
-    void registerUser(WiFiUser* user) {
-        users.push_back(user);
+    ~TimelineOutput() {
+        if (path.empty()) return;
+        std::ofstream out(path);
+        Timeline::instance().write(out);
+        if (!out) cerr << "Cannot write timeline file '" << path << "'\n";
     }
+};
 
-    void simulateMU_MIMO(int numPackets) {
-        vector<double> latencies;
-        double totalThroughput = 0;
-        cout << "--- WiFi 5 MU-MIMO Simulation ---\n";
-        cout << "Number of Users: " << users.size() << "\n";
-
-        for (int t = 0; t < numPackets; ++t) {
-            for (auto& user : users) {
-                double latency = 0.0;
-                if (user->attemptToTransmit(channel, latency, 0.1)) {
-                    totalThroughput += 20e6 * 8 * (5.0 / 6.0); // Transfer rate for WiFi 5
-                    latencies.push_back(latency);
+// Main function with user choice
+int main(int argc, char* argv[]) {
+    SimulationOptions options;
+    BatchOptions batch;
+    TimelineOutput timeline;
+    string traceFile;
+    uint32_t traceSample = 1;
+    TraceEncoding traceEncoding = TraceEncoding::Compact;
+    uint32_t traceTick = 1;
+    string pcapFile;
+    PcapStation pcapStation = PcapStation::Source;
+    try {
+        for (int i = 1; i < argc; ++i) {
+            string arg = argv[i];
+            if (arg == "--queue" && i + 1 < argc) {
+                string backend = argv[++i];
+                if (backend == "heap") {
+                    options.queueBackend = QueueBackend::BinaryHeap;
+                } else if (backend == "wheel") {
+                    options.queueBackend = QueueBackend::TimingWheel;
+                } else {
+                    cerr << "Unknown event queue '" << backend << "' (expected heap or wheel)\n";
+                    return 1;
+                }
+            } else if (arg == "--contention" && i + 1 < argc) {
+                string engine = argv[++i];
+                if (engine == "event") {
+                    options.contention = ContentionEngine::EventDriven;
+                } else if (engine == "slotted") {
+                    options.contention = ContentionEngine::Slotted;
+                } else if (engine == "lockstep") {
+                    options.contention = ContentionEngine::Lockstep;
+                } else {
+                    cerr << "Unknown contention engine '" << engine << "' (expected event, slotted or lockstep)\n";
+                    return 1;
+                }
+            } else if (arg == "--replications" && i + 1 < argc) {
+                options.replications = parseOptionValue<int>(arg, argv[++i], [](int r) { return r > 0; }, "a positive count");
+            } else if (arg == "--latency-bits" && i + 1 < argc) {
+                options.latencyPrecisionBits = parseOptionValue<int>(arg, argv[++i], [](int b) { return b >= 2 && b <= 16; }, "2 to 16 bits");
+            } else if (arg == "--ci-target" && i + 1 < argc) {
+                options.stopping.relativeHalfWidth =
+                    parseOptionValue<double>(arg, argv[++i], [](double r) { return r >= 0; }, "a relative width, 0 for none");
+            } else if (arg == "--confidence" && i + 1 < argc) {
+                options.stopping.confidence =
+                    parseOptionValue<double>(arg, argv[++i], [](double c) { return c > 0 && c < 1; }, "a level between 0 and 1");
+            } else if (arg == "--warmup" && i + 1 < argc) {
+                string method = argv[++i];
+                if (method == "mser5") {
+                    options.truncateWarmup = true;
+                } else if (method == "none") {
+                    options.truncateWarmup = false;
+                } else {
+                    cerr << "Unknown warm-up method '" << method << "' (expected mser5 or none)\n";
+                    return 1;
                 }
+            } else if (arg == "--seed" && i + 1 < argc) {
+                options.seed = parseOptionValue<uint64_t>(arg, argv[++i], [](uint64_t) { return true; }, "a non-negative integer");
+            } else if (arg == "--generation" && i + 1 < argc) {
+                if (!parseSweepArgument(batch.sweep, string("generation=") + argv[++i])) return 1;
+            } else if (arg == "--clients" && i + 1 < argc) {
+                if (!parseSweepArgument(batch.sweep, string("clients=") + argv[++i])) return 1;
+            } else if (arg == "--packets" && i + 1 < argc) {
+                if (!parseSweepArgument(batch.sweep, string("packets=") + argv[++i])) return 1;
+            } else if (arg == "--mcs" && i + 1 < argc) {
+                if (!parseSweepArgument(batch.sweep, string("mcs=") + argv[++i])) return 1;
+            } else if (arg == "--seeds" && i + 1 < argc) {
+                if (!parseSweepArgument(batch.sweep, string("seed=") + argv[++i])) return 1;
+            } else if (arg == "--sweep" && i + 1 < argc) {
+                if (!parseSweepArgument(batch.sweep, argv[++i])) return 1;
+            } else if (arg == "--threads" && i + 1 < argc) {
+                options.threads = parseOptionValue<int>(arg, argv[++i], [](int t) { return t >= 0; }, "a count, 0 for one per hardware thread");
+            } else if (arg == "--scenarios" && i + 1 < argc) {
+                batch.scenarioFile = argv[++i];
+            } else if (arg == "--output" && i + 1 < argc) {
+                batch.outputFile = argv[++i];
+            } else if (arg == "--merged") {
+                batch.merged = true;
+            } else if (arg == "--trace" && i + 1 < argc) {
+                traceFile = argv[++i];
+            } else if (arg == "--trace-sample" && i + 1 < argc) {
+                traceSample = parseOptionValue<uint32_t>(arg, argv[++i], [](uint32_t n) { return n > 0; }, "a positive sampling interval");
+            } else if (arg == "--trace-encoding" && i + 1 < argc) {
+                string encoding = argv[++i];
+                if (encoding == "compact") {
+                    traceEncoding = TraceEncoding::Compact;
+                } else if (encoding == "raw") {
+                    traceEncoding = TraceEncoding::Raw;
+                } else {
+                    cerr << "Unknown trace encoding '" << encoding << "' (expected compact or raw)\n";
+                    return 1;
+                }
+            } else if (arg == "--trace-tick" && i + 1 < argc) {
+                traceTick = parseOptionValue<uint32_t>(arg, argv[++i], [](uint32_t ns) { return ns > 0; }, "a positive tick in ns");
+            } else if (arg == "--arrivals" && i + 1 < argc) {
+                batch.arrivalsFile = argv[++i];
+            } else if (arg == "--import-pcap" && i + 1 < argc) {
+                pcapFile = argv[++i];
+            } else if (arg == "--timeline" && i + 1 < argc) {
+                timeline.path = argv[++i];
+            } else if (arg == "--perf-counters") {
+                perfCountersRequested() = true;
+            } else if (arg == "--import-by" && i + 1 < argc) {
+                string address = argv[++i];
+                if (address == "src") {
+                    pcapStation = PcapStation::Source;
+                } else if (address == "dst") {
+                    pcapStation = PcapStation::Destination;
+                } else {
+                    cerr << "Unknown station address '" << address << "' (expected src or dst)\n";
+                    return 1;
+                }
+            } else {
+                printUsage(argv[0]);
+                return 1;
             }
         }
-
-        // Calculate statistics
-        double avgLatency = accumulate(latencies.begin(), latencies.end(), 0.0) / latencies.size();
-        double maxLatency = *max_element(latencies.begin(), latencies.end());
-
-        cout << "Total Throughput: " << totalThroughput / 1e6 << " Mbps\n";
-        cout << "Average Latency: " << avgLatency << " ms\n";
-        cout << "Max Latency: " << maxLatency << " ms\n";
+    } catch (const invalid_argument& e) {
+        cerr << e.what() << "\n";
+        printUsage(argv[0]);
+        return 1;
     }
-};
-
 
-// WiFi 6 Access Point with OFDMA support
-class WiFi6AccessPoint {
-private:
-    double bandwidth;
-    double bitsPerSymbol;
-    double codingRate;
-    vector<WiFi6User*> users;
-    FreqChannel channel;  // Add channel as a member variable
-
-public:
-    WiFi6AccessPoint(double bandwidth, double bitsPerSymbol, double codingRate)
-        : bandwidth(bandwidth), bitsPerSymbol(bitsPerSymbol), codingRate(codingRate), channel("WiFi6_Channel") {}
-
-    void registerUser(WiFi6User* user) {
-        users.push_back(user);
+    if (!timeline.path.empty()) {
+        Timeline::instance().enable();
+        Timeline::instance().nameThread("main");
     }
 
-    void simulateOFDMA(int numPackets) {
-        double totalThroughput = 0;
-        vector<double> userLatencies;
-        int subChannelIndex = 0;
-
-        for (int t = 0; t < numPackets; ++t) {  // Simulating 100 time slots
-            for (size_t i = 0; i < users.size(); ++i) {
-                WiFi6User* user = users[i];
-                user->allocateSubChannel(subChannelIndex);
-
-                if (user->attemptTransmission(channel, subChannelIndex)) {
-                    double throughput = (bandwidth / users.size()) * 8.0 * codingRate;
-                    totalThroughput += throughput;
+    if (options.threads == 0) {
+        options.threads = static_cast<int>(std::max(std::thread::hardware_concurrency(), 1u));
+    }
 
-                    // Add latency (simulated)
-                    userLatencies.push_back((rand() % 100) * 0.1);
-                }
-                subChannelIndex = (subChannelIndex + 1) % 10;
-            }
+    // Binary per-packet trace, written in the background; every Nth packet with --trace-sample N
+    std::unique_ptr<TraceWriter> trace;
+    if (!traceFile.empty()) {
+        trace.reset(new TraceWriter(traceFile, traceSample, traceEncoding, traceTick));
+        if (!trace->good()) {
+            cerr << "Cannot write trace file '" << traceFile << "'\n";
+            return 1;
         }
-
-        // Calculate statistics
-        double avgLatency = accumulate(userLatencies.begin(), userLatencies.end(), 0.0) / userLatencies.size();
-        double maxLatency = *max_element(userLatencies.begin(), userLatencies.end());
-
-        cout << "Total Throughput: " << totalThroughput / 1e6 << " Mbps\n";
-        cout << "Average Latency: " << avgLatency << " ms\n";
-        cout << "Max Latency: " << maxLatency << " ms\n";
+        options.trace = trace.get();
     }
-};
-
-
-// Run WiFi 4 simulation
-void runWiFi4Simulation(int numClients, int numPackets) {
-    WiFi4AccessPoint ap;
-    for (int i = 0; i < numClients; ++i) {
-        ap.addClient(WiFiUser(i));
+    // Flushes the trace; a write that failed at any point fails the run
+    auto closeTrace = [&trace, &traceFile]() {
+        if (!trace) return true;
+        trace->close();
+        if (trace->good()) return true;
+        cerr << "Cannot write trace file '" << traceFile << "'\n";
+        return false;
+    };
+
+    // Recorded traffic instead of saturated queues, converted from a pcap
+    // capture first when one is given
+    std::unique_ptr<ArrivalTrace> arrivals;
+    if (!pcapFile.empty() && batch.arrivalsFile.empty()) {
+        cerr << "--import-pcap needs --arrivals FILE to write the arrivals to\n";
+        return 1;
     }
-    ap.simulateNetwork(numPackets);
-    ap.displayStatistics();
-}
-
-// Run WiFi 5 simulation
-void runWiFi5Simulation(int numClients, int numPackets) {
-    WiFi5AccessPoint ap;
-    for (int i = 0; i < numClients; ++i) {
-        ap.registerUser(new WiFiUser(i));
+    try {
+        if (!pcapFile.empty()) {
+            PcapImport imported = importPcap(pcapFile, batch.arrivalsFile, pcapStation);
+            cerr << "Imported " << imported.frames << " frames from " << imported.stations << " stations ("
+                 << toSeconds(imported.duration) << " s; " << imported.skipped << " frames without an address skipped, "
+                 << imported.reordered << " out of order) into " << batch.arrivalsFile << "\n";
+        }
+        if (!batch.arrivalsFile.empty()) {
+            arrivals.reset(new ArrivalTrace(batch.arrivalsFile));
+            options.arrivals = arrivals.get();
+        }
+    } catch (const exception& e) {
+        cerr << e.what() << "\n";
+        return 1;
     }
-    ap.simulateMU_MIMO(numPackets);
-}
-
-// Run WiFi 6 simulation
-void runWiFi6Simulation(int numClients, int numPackets) {
-    double bandwidth = 20e6;       // 20 MHz channel
-    double bitsPerSymbol = 8.0;    // 256-QAM
-    double codingRate = 5.0 / 6.0; // Coding rate 5/6
 
-    WiFi6AccessPoint ap(bandwidth, bitsPerSymbol, codingRate);
-
-    for (int i = 0; i < numClients; ++i) {
-        ap.registerUser(new WiFi6User(i));
+    // Any scenario on the command line or in a file: run them all, print CSV
+    if (batch.requested()) {
+        int status = runBatch(batch, options);
+        return closeTrace() ? status : 1;
     }
 
-    ap.simulateOFDMA(numPackets);
-}
-
-// Main function with user choice
-int main() {
-    srand(time(0));
-
     int choice;
     while (true) {
         cout << "Choose WiFi Simulation Type:\n";
@@ -361,25 +366,31 @@ int main() {
         cout << "Enter number of packets: ";
         cin >> numPackets;
 
-        // Running different user scenarios
-        if (choice == 1) {
-            cout << "\nWiFi 4 Simulation\n";
-            for (int numClients : {1, 10, 100}) {
-                cout << "\nSimulating with " << numClients << " clients:\n";
-                runWiFi4Simulation(numClients, numPackets);
-            }
-        } else if (choice == 2) {
-            cout << "\nWiFi 5 Simulation\n";
-            for (int numClients : {1, 10, 100}) {
-                cout << "\nSimulating with " << numClients << " clients:\n";
-                runWiFi5Simulation(numClients, numPackets);
-            }
-        } else if (choice == 3) {
-            cout << "\nWiFi 6 Simulation\n";
-            for (int numClients : {1, 10, 100}) {
-                cout << "\nSimulating with " << numClients << " clients:\n";
-                runWiFi6Simulation(numClients, numPackets);
+        if (choice >= 1 && choice <= 3) {
+            // The menu's sweep: 1, 10 and 100 clients. Reports are printed in
+            // order and the generation report merges every cell's sketch.
+            int generation = choice + 3;
+            SweepSpec sweep;
+            sweep.generations = {generation};
+            sweep.clients = {1, 10, 100};
+            sweep.packets = {numPackets};
+            sweep.mcs = {defaultMcs};
+            sweep.seeds = {static_cast<int64_t>(options.seed)};
+            std::vector<Scenario> scenarios;
+            sweep.expand(scenarios);
+            RunnerStats stats;
+            std::vector<ScenarioOutcome> outcomes = runScenarios(scenarios, options, true, stats);
+
+            cout << "\nWiFi " << generation << " Simulation\n";
+            QuantileSketch generationLatencies;
+            for (size_t i = 0; i < scenarios.size(); ++i) {
+                cout << "\nSimulating with " << scenarios[i].clients << " clients:\n";
+                cout << outcomes[i].report;
+                generationLatencies.merge(outcomes[i].latencies);
             }
+            cout << "\n";
+            printSketchSummary(cout, "WiFi " + to_string(generation) + ", all cells", generationLatencies);
+            printRunnerStats(cout, stats);
         } else {
             cout << "Invalid choice. Please try again.\n";
         }
@@ -395,6 +406,6 @@ int main() {
         }
     }
 
-    return 0;
+    return closeTrace() ? 0 : 1;
 }
 
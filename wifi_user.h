@@ -0,0 +1,77 @@
+#ifndef WIFI_USER_H
+#define WIFI_USER_H
+
+#include <cstddef>
+#include <cstdint>
+
+#include "rng.h"
+#include "station_table.h"
+
+// WiFi 4 User class simulating behavior
+class WiFiUser {
+private:
+    int id;
+    double backoffInterval;
+    int collisionCount;
+    bool waitingForAccess;
+    RandomStream random;
+
+public:
+    WiFiUser(int id, const RngKey& key = RngKey())
+        : id(id), collisionCount(0), waitingForAccess(false), random(key, static_cast<uint32_t>(id)) {
+        resetBackoffInterval();
+    }
+
+    // Uniform draw from a window that doubles with every collision. Scaling a
+    // single draw instead would pin every repeat collider at the 450 cap,
+    // where equal backoffs collide forever on a shared medium.
+    void resetBackoffInterval() {
+        applyBackoffDraw(random.next());
+    }
+
+    // Batched form of resetBackoffInterval(): reserve the draw from this
+    // station's stream, then apply the value once the batch is generated
+    size_t reserveBackoffDraw(RngBatch& batch) { return random.reserve(batch); }
+
+    void applyBackoffDraw(uint32_t draw) {
+        backoffInterval = scaleDraw(draw, StationTable::contentionWindow(collisionCount)) + 1;
+    }
+
+    // Per-attempt loss model used by the MU-MIMO scheduler: a failed attempt
+    // doubles the backoff window and sits out the next opportunity.
+    bool attemptToTransmit(double congestionFactor) {
+        if (waitingForAccess) {
+            waitingForAccess = false;
+            return false;
+        }
+
+        bool collisionOccurred = (random.uniformInt(150) < congestionFactor * 100);
+
+        if (!collisionOccurred) {
+            collisionCount = 0;
+            return true;
+        } else {
+            registerCollision();
+            waitingForAccess = true;
+            return false;
+        }
+    }
+
+    // Our frame overlapped another station's: widen the contention window
+    void registerCollision() {
+        widenContentionWindow();
+        resetBackoffInterval();
+    }
+
+    void widenContentionWindow() { collisionCount++; }
+
+    void registerSuccess() { collisionCount = 0; }
+
+    int getID() const { return id; }
+    int getCollisionCount() const { return collisionCount; }
+    double getBackoffInterval() const { return backoffInterval; }
+    bool isWaitingForAccess() const { return waitingForAccess; }
+    uint64_t getDrawsUsed() const { return random.position(); }
+};
+
+#endif
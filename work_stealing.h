@@ -0,0 +1,84 @@
+#ifndef WORK_STEALING_H
+#define WORK_STEALING_H
+
+#include <cstddef>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Runs a batch of independent, coarse-grained tasks on a fixed number of
+// threads. Tasks are dealt round-robin, in the order given, into one deque
+// per worker; a worker takes its own tasks from the front and, once its
+// deque is empty, steals from the back of the others'. Dealing the most
+// expensive tasks first keeps a worker stuck on a large case from holding
+// up the small ones queued behind it. Each deque has its own lock: tasks
+// are whole simulations, so contention is negligible.
+class WorkStealingPool {
+private:
+    struct Worker {
+        std::mutex lock;
+        std::deque<size_t> tasks;
+    };
+
+    int threadCount;
+    std::vector<std::unique_ptr<Worker>> workers;
+
+    bool popOwn(int self, size_t& task) {
+        Worker& worker = *workers[self];
+        std::lock_guard<std::mutex> guard(worker.lock);
+        if (worker.tasks.empty()) return false;
+        task = worker.tasks.front();
+        worker.tasks.pop_front();
+        return true;
+    }
+
+    bool steal(int self, size_t& task) {
+        for (int offset = 1; offset < threadCount; ++offset) {
+            Worker& victim = *workers[(self + offset) % threadCount];
+            std::lock_guard<std::mutex> guard(victim.lock);
+            if (victim.tasks.empty()) continue;
+            task = victim.tasks.back();
+            victim.tasks.pop_back();
+            return true;
+        }
+        return false;
+    }
+
+public:
+    explicit WorkStealingPool(int threads) : threadCount(threads > 0 ? threads : 1) {
+        for (int t = 0; t < threadCount; ++t) {
+            workers.emplace_back(new Worker);
+        }
+    }
+
+    int size() const { return threadCount; }
+
+    // Calls run(task, worker) once for every task id in `order`, where worker
+    // is in [0, size()). The calling thread works as worker 0; returns when
+    // every task is done. No new tasks appear during a run, so a worker
+    // that finds every deque empty is finished.
+    template <typename Run>
+    void run(const std::vector<size_t>& order, Run run) {
+        for (size_t i = 0; i < order.size(); ++i) {
+            workers[i % threadCount]->tasks.push_back(order[i]);
+        }
+        auto work = [&](int self) {
+            size_t task;
+            while (popOwn(self, task) || steal(self, task)) {
+                run(task, self);
+            }
+        };
+        std::vector<std::thread> threads;
+        for (int t = 1; t < threadCount; ++t) {
+            threads.emplace_back(work, t);
+        }
+        work(0);
+        for (std::thread& thread : threads) {
+            thread.join();
+        }
+    }
+};
+
+#endif